@@ -0,0 +1,374 @@
+/* imu-v2-brick
+ *
+ * bench.c: Benchmarks of the firmware on the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "hal.h"
+#include "bno055.h"
+#include "transport.h"
+
+#include "config.h"
+#include "communication.h"
+#include "imu.h"
+
+#include "bricklib/utility/util_definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+// Measures the firmware on the host and prints the results as JSON:
+//  * CPU time of the calculation and message tick (host ns)
+//  * jitter of the callback intervals (simulated µs)
+//  * callback throughput with 1 to 9 active period callbacks
+//  * request/response throughput of the getters
+// CPU times are host times, they show relative costs and regressions, not
+// the cycles on the brick. Everything else is simulated time.
+
+#define BENCH_PERIOD_CALLBACKS 9 // IMU_PERIOD_TYPE_ACC to IMU_PERIOD_TYPE_ALL
+#define BENCH_SETTLE_TIME      100 // in ms
+
+typedef struct {
+	uint64_t *samples;
+	uint32_t count;
+	uint32_t size;
+} BenchSamples;
+
+typedef struct {
+	uint32_t period;   // in µs
+	uint64_t last;     // in µs
+	uint32_t count;
+	uint32_t intervals;
+	double deviation_sum;
+	double deviation_square_sum;
+	uint32_t deviation_max;
+} BenchJitter;
+
+static const char *bench_period_name[BENCH_PERIOD_CALLBACKS] = {
+	"acceleration", "magnetic_field", "angular_velocity", "temperature",
+	"orientation", "linear_acceleration", "gravity_vector", "quaternion",
+	"all_data"
+};
+
+static BenchSamples bench_tick[2];
+static BenchJitter bench_jitter[BENCH_PERIOD_CALLBACKS];
+static uint64_t bench_callback_bytes = 0;
+static uint32_t bench_callbacks = 0;
+
+static void bench_samples_add(BenchSamples *samples, const uint64_t value) {
+	if(samples->count == samples->size) {
+		samples->size = samples->size == 0 ? 4096 : samples->size*2;
+		samples->samples = realloc(samples->samples, samples->size*sizeof(uint64_t));
+		if(samples->samples == NULL) {
+			fprintf(stderr, "bench: out of memory\n");
+			exit(1);
+		}
+	}
+
+	samples->samples[samples->count++] = value;
+}
+
+static int bench_compare(const void *a, const void *b) {
+	const uint64_t x = *(const uint64_t *)a;
+	const uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void bench_print_samples(FILE *file, const BenchSamples *samples) {
+	if(samples->count == 0) {
+		fprintf(file, "{\"count\": 0}");
+		return;
+	}
+
+	qsort(samples->samples, samples->count, sizeof(uint64_t), bench_compare);
+
+	uint64_t sum = 0;
+	for(uint32_t i = 0; i < samples->count; i++) {
+		sum += samples->samples[i];
+	}
+
+	fprintf(file,
+	        "{\"count\": %u, \"min_ns\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+	        samples->count,
+	        (unsigned long long)samples->samples[0],
+	        (unsigned long long)(sum/samples->count),
+	        (unsigned long long)samples->samples[samples->count/2],
+	        (unsigned long long)samples->samples[(samples->count*99)/100],
+	        (unsigned long long)samples->samples[samples->count - 1]);
+}
+
+static void bench_tick_listener(const uint8_t tick_type, const uint64_t host_ns) {
+	bench_samples_add(&bench_tick[tick_type == TICK_TASK_TYPE_MESSAGE ? 1 : 0], host_ns);
+}
+
+static void bench_message_listener(const TransportMessage *message) {
+	const MessageHeader *header = (const MessageHeader *)message->data;
+	if((header->fid < FID_ACCELERATION) || (header->fid > FID_ALL_DATA)) {
+		return;
+	}
+
+	bench_callbacks++;
+	bench_callback_bytes += message->length;
+
+	BenchJitter *jitter = &bench_jitter[header->fid - FID_ACCELERATION];
+	if(jitter->count > 0) {
+		const double deviation = (double)(message->time - jitter->last) - jitter->period;
+		jitter->deviation_sum        += deviation;
+		jitter->deviation_square_sum += deviation*deviation;
+		jitter->deviation_max         = MAX(jitter->deviation_max, (uint32_t)fabs(deviation));
+		jitter->intervals++;
+	}
+
+	jitter->last = message->time;
+	jitter->count++;
+}
+
+static void bench_reset(void) {
+	for(uint8_t i = 0; i < 2; i++) {
+		bench_tick[i].count = 0;
+	}
+
+	memset(bench_jitter, 0, sizeof(bench_jitter));
+	bench_callback_bytes = 0;
+	bench_callbacks = 0;
+
+	hal_reset_statistics();
+	bno055_reset_statistics();
+	transport_clear();
+}
+
+static void bench_request(const uint8_t fid, const void *payload, const uint8_t length) {
+	if(transport_request(fid, payload, length, true, NULL, NULL) != MESSAGE_ERROR_CODE_OK) {
+		fprintf(stderr, "bench: request %d failed\n", fid);
+		exit(1);
+	}
+}
+
+static void bench_set_periods(const uint8_t active, const uint32_t period) {
+	SetCallbackPeriods scp;
+	memset(scp.periods, 0, sizeof(scp.periods));
+	for(uint8_t i = 0; i < active; i++) {
+		scp.periods[i] = period;
+	}
+
+	bench_request(FID_SET_CALLBACK_PERIODS, scp.periods, sizeof(scp.periods));
+}
+
+static void bench_throughput(FILE *file, const uint8_t active, const uint32_t period, const uint32_t duration) {
+	bench_set_periods(active, period);
+	hal_run_ms(BENCH_SETTLE_TIME);
+	bench_reset();
+
+	for(uint8_t i = 0; i < BENCH_PERIOD_CALLBACKS; i++) {
+		bench_jitter[i].period = imu_get_effective_period(i)*1000;
+	}
+
+	GetAcquisitionStatisticsReturn before, after;
+	transport_request(FID_GET_ACQUISITION_STATISTICS, NULL, 0, true, &before, NULL);
+
+	const uint64_t host_start = hal_get_host_ns();
+	hal_run_ms(duration);
+	const uint64_t host_ns = hal_get_host_ns() - host_start;
+
+	transport_request(FID_GET_ACQUISITION_STATISTICS, NULL, 0, true, &after, NULL);
+
+	const HALStatistics *hal = hal_get_statistics();
+	const double seconds = duration/1000.0;
+
+	fprintf(file, "    {\"active_periods\": %u, \"period_ms\": %u, \"callbacks\": %u, "
+	              "\"callbacks_per_s\": %.1f, \"bytes_per_s\": %.1f, "
+	              "\"samples_read\": %u, \"samples_missed\": %u, "
+	              "\"twi_busy_percent\": %.2f, \"host_ns_per_simulated_s\": %.0f,\n",
+	        active,
+	        period,
+	        bench_callbacks,
+	        bench_callbacks/seconds,
+	        bench_callback_bytes/seconds,
+	        after.samples_read - before.samples_read,
+	        after.samples_missed - before.samples_missed,
+	        hal->twi_busy_ns/(duration*10000.0),
+	        host_ns/seconds);
+
+	fprintf(file, "     \"tick_calculation\": ");
+	bench_print_samples(file, &bench_tick[0]);
+	fprintf(file, ",\n     \"tick_message\": ");
+	bench_print_samples(file, &bench_tick[1]);
+	fprintf(file, ",\n     \"jitter\": [");
+
+	for(uint8_t i = 0; i < active; i++) {
+		const BenchJitter *jitter = &bench_jitter[i];
+		const uint32_t n = MAX(jitter->intervals, 1);
+		const double mean = jitter->deviation_sum/n;
+		const double variance = jitter->deviation_square_sum/n - mean*mean;
+
+		fprintf(file, "%s\n      {\"callback\": \"%s\", \"period_us\": %u, \"count\": %u, "
+		              "\"mean_deviation_us\": %.2f, \"stddev_us\": %.2f, \"max_deviation_us\": %u}",
+		        i == 0 ? "" : ",",
+		        bench_period_name[i],
+		        jitter->period,
+		        jitter->count,
+		        mean,
+		        sqrt(MAX(variance, 0.0)),
+		        jitter->deviation_max);
+	}
+
+	fprintf(file, "\n     ]}");
+}
+
+// burst: all requests at the same simulated time, the data is read once
+// paced: one request per ms, the getter reads when its channels are stale
+static void bench_getter(FILE *file, const char *name, const uint8_t fid, const bool paced, const uint32_t requests) {
+	bench_set_periods(0, 0);
+	hal_run_ms(BENCH_SETTLE_TIME);
+	bench_reset();
+
+	uint32_t responses = 0;
+	uint64_t host_ns = 0;
+	const uint64_t time_start = hal_get_time_us();
+	uint64_t time_requests = 0;
+
+	for(uint32_t i = 0; i < requests; i++) {
+		if(paced) {
+			hal_run_ms(1);
+		}
+
+		const uint64_t time = hal_get_time_us();
+		const uint64_t start = hal_get_host_ns();
+		if(transport_request(fid, NULL, 0, true, NULL, NULL) == MESSAGE_ERROR_CODE_OK) {
+			responses++;
+		}
+		host_ns += hal_get_host_ns() - start;
+		time_requests += hal_get_time_us() - time;
+	}
+
+	const BNO055Statistics *bno = bno055_get_statistics();
+
+	fprintf(file, "    {\"getter\": \"%s\", \"pattern\": \"%s\", \"requests\": %u, \"responses\": %u, "
+	              "\"host_ns_per_request\": %.0f, \"requests_per_host_s\": %.0f, "
+	              "\"simulated_us_per_request\": %.2f, \"simulated_us\": %llu, \"twi_reads\": %u}",
+	        name,
+	        paced ? "paced" : "burst",
+	        requests,
+	        responses,
+	        (double)host_ns/requests,
+	        requests*1e9/MAX(host_ns, 1),
+	        (double)time_requests/requests,
+	        (unsigned long long)(hal_get_time_us() - time_start),
+	        bno->reads);
+}
+
+static void bench_usage(const char *name) {
+	fprintf(stderr,
+	        "usage: %s [options]\n"
+	        "  --duration MS   simulated time per throughput run (default 2000)\n"
+	        "  --period MS     callback period of the throughput runs (default 1)\n"
+	        "  --requests N    requests per getter run (default 1000)\n"
+	        "  --output FILE   write the JSON to FILE instead of stdout\n",
+	        name);
+}
+
+int main(int argc, char **argv) {
+	uint32_t duration = 2000;
+	uint32_t period = 1;
+	uint32_t requests = 1000;
+	const char *output = NULL;
+
+	static const struct option options[] = {
+		{"duration", required_argument, NULL, 'd'},
+		{"period",   required_argument, NULL, 'p'},
+		{"requests", required_argument, NULL, 'r'},
+		{"output",   required_argument, NULL, 'o'},
+		{"help",     no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int option;
+	while((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch(option) {
+			case 'd': duration = atoi(optarg); break;
+			case 'p': period = atoi(optarg); break;
+			case 'r': requests = atoi(optarg); break;
+			case 'o': output = optarg; break;
+			case 'h': bench_usage(argv[0]); return 0;
+			default: bench_usage(argv[0]); return 2;
+		}
+	}
+
+	if((duration == 0) || (period == 0) || (requests == 0)) {
+		bench_usage(argv[0]);
+		return 2;
+	}
+
+	FILE *file = stdout;
+	if(output != NULL) {
+		file = fopen(output, "w");
+		if(file == NULL) {
+			perror(output);
+			return 1;
+		}
+	}
+
+	hal_init();
+	transport_init();
+	imu_init();
+	hal_start_scheduler();
+
+	transport_set_recording(false);
+	transport_set_listener(bench_message_listener);
+	hal_set_tick_listener(bench_tick_listener);
+
+	fprintf(file, "{\n  \"firmware_version\": \"%d.%d.%d\",\n",
+	        BRICK_FIRMWARE_VERSION_MAJOR, BRICK_FIRMWARE_VERSION_MINOR, BRICK_FIRMWARE_VERSION_REVISION);
+	fprintf(file, "  \"operation_mode\": %d,\n  \"duration_ms\": %u,\n  \"requests\": %u,\n",
+	        bno055_get_operation_mode(), duration, requests);
+
+	fprintf(file, "  \"throughput\": [\n");
+	for(uint8_t active = 1; active <= BENCH_PERIOD_CALLBACKS; active++) {
+		bench_throughput(file, active, period, duration);
+		fprintf(file, "%s\n", active < BENCH_PERIOD_CALLBACKS ? "," : "");
+	}
+	fprintf(file, "  ],\n");
+
+	static const struct {
+		const char *name;
+		uint8_t fid;
+	} getters[] = {
+		{"get_acceleration", FID_GET_ACCELERATION},
+		{"get_orientation",  FID_GET_ORIENTATION},
+		{"get_quaternion",   FID_GET_QUATERNION},
+		{"get_all_data",     FID_GET_ALL_DATA}
+	};
+	const uint8_t getter_num = sizeof(getters)/sizeof(getters[0]);
+
+	fprintf(file, "  \"getters\": [\n");
+	for(uint8_t i = 0; i < getter_num; i++) {
+		for(uint8_t paced = 0; paced < 2; paced++) {
+			bench_getter(file, getters[i].name, getters[i].fid, paced, requests);
+			fprintf(file, "%s\n", (i < getter_num - 1) || (paced == 0) ? "," : "");
+		}
+	}
+	fprintf(file, "  ]\n}\n");
+
+	if(file != stdout) {
+		fclose(file);
+	}
+
+	return 0;
+}
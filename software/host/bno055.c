@@ -0,0 +1,444 @@
+/* imu-v2-brick
+ *
+ * bno055.c: Software model of the BNO055 for the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "bno055.h"
+
+#include <math.h>
+#include <string.h>
+
+#define BNO055_SOURCE_FUSION 0
+#define BNO055_SOURCE_ACC    1
+#define BNO055_SOURCE_GYR    2
+#define BNO055_SOURCE_MAG    3
+#define BNO055_SOURCE_NUM    4
+
+#define BNO055_GRAVITY       9.80665f
+#define BNO055_PI            3.14159265f
+
+typedef struct {
+	bool enabled;
+	uint32_t period; // in µs
+	uint64_t next;   // in µs
+} BNO055Source;
+
+static uint8_t bno055_page[2][BNO055_PAGE_SIZE];
+static uint8_t bno055_page_id = 0;
+static uint8_t bno055_mode = BNO055_MODE_CONFIG;
+static uint8_t bno055_power = BNO055_POWER_NORMAL;
+static uint64_t bno055_mode_ready = 0;
+static uint64_t bno055_time = 0;
+static bool bno055_int = false;
+static void (*bno055_int_handler)(void) = NULL;
+static BNO055Source bno055_source[BNO055_SOURCE_NUM];
+static BNO055Statistics bno055_statistics;
+static float bno055_rotation_rate = 30.0f; // in °/s about z
+static uint32_t bno055_noise = 12345;
+
+// Output data periods in µs, indexed with the bandwidth/rate field of the
+// page 1 configuration registers. The accelerometer outputs data with
+// twice its bandwidth.
+static const uint32_t bno055_acc_period[8] = {64000, 32000, 16000, 8000, 4000, 2000, 1000, 500};
+static const uint32_t bno055_gyr_period[8] = {500, 500, 1000, 2500, 5000, 10000, 5000, 10000};
+static const uint32_t bno055_mag_period[8] = {500000, 166667, 125000, 100000, 66667, 50000, 40000, 33333};
+
+static bool bno055_mode_uses(const uint8_t mode, const uint8_t source) {
+	switch(source) {
+		case BNO055_SOURCE_FUSION: return mode >= BNO055_MODE_IMU;
+		case BNO055_SOURCE_ACC:    return (mode != BNO055_MODE_CONFIG) && (mode != BNO055_MODE_MAGONLY) &&
+		                                  (mode != BNO055_MODE_GYROONLY) && (mode != BNO055_MODE_MAGGYRO);
+		case BNO055_SOURCE_GYR:    return (mode == BNO055_MODE_GYROONLY) || (mode == BNO055_MODE_ACCGYRO) ||
+		                                  (mode == BNO055_MODE_MAGGYRO) || (mode == BNO055_MODE_AMG) ||
+		                                  (mode == BNO055_MODE_IMU) || (mode >= BNO055_MODE_NDOF_FMC_OFF);
+		case BNO055_SOURCE_MAG:    return (mode == BNO055_MODE_MAGONLY) || (mode == BNO055_MODE_ACCMAG) ||
+		                                  (mode == BNO055_MODE_MAGGYRO) || (mode == BNO055_MODE_AMG) ||
+		                                  (mode >= BNO055_MODE_COMPASS);
+	}
+
+	return false;
+}
+
+// In the fusion modes all data registers are updated with the fusion
+// output rate, in the non-fusion modes every sensor has its own rate
+static void bno055_update_sources(void) {
+	const bool fusion = bno055_mode >= BNO055_MODE_IMU;
+	const bool active = (bno055_mode != BNO055_MODE_CONFIG) && (bno055_power == BNO055_POWER_NORMAL);
+
+	for(uint8_t i = 0; i < BNO055_SOURCE_NUM; i++) {
+		BNO055Source *source = &bno055_source[i];
+		source->enabled = active && bno055_mode_uses(bno055_mode, i) && (fusion == (i == BNO055_SOURCE_FUSION));
+
+		switch(i) {
+			case BNO055_SOURCE_FUSION: source->period = BNO055_FUSION_PERIOD; break;
+			case BNO055_SOURCE_ACC:    source->period = bno055_acc_period[(bno055_page[1][BNO055_REG_ACC_CONFIG] >> 2) & 7]; break;
+			case BNO055_SOURCE_GYR:    source->period = bno055_gyr_period[(bno055_page[1][BNO055_REG_GYR_CONFIG_0] >> 3) & 7]; break;
+			case BNO055_SOURCE_MAG:    source->period = bno055_mag_period[bno055_page[1][BNO055_REG_MAG_CONFIG] & 7]; break;
+		}
+
+		source->next = (bno055_mode_ready > bno055_time ? bno055_mode_ready : bno055_time) + source->period;
+	}
+}
+
+static void bno055_set_int(const bool level) {
+	const bool edge = level && !bno055_int;
+	bno055_int = level;
+	if(edge && (bno055_int_handler != NULL)) {
+		bno055_int_handler();
+	}
+}
+
+void bno055_trigger_interrupt(const uint8_t status, const uint64_t time) {
+	(void)time;
+	const uint8_t enabled = status & bno055_page[1][BNO055_REG_INT_EN];
+	bno055_page[0][BNO055_REG_INT_STA] |= enabled;
+	if(enabled & bno055_page[1][BNO055_REG_INT_MSK]) {
+		bno055_set_int(true);
+	}
+}
+
+static int16_t bno055_noise_lsb(void) {
+	bno055_noise = bno055_noise*1103515245 + 12345;
+	return ((bno055_noise >> 16) % 3) - 1;
+}
+
+static void bno055_put(const uint8_t reg, const float value, const bool noise) {
+	int32_t v = (int32_t)lroundf(value);
+	if(noise) {
+		v += bno055_noise_lsb();
+	}
+	v = v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v);
+
+	bno055_page[0][reg]     = ((uint16_t)v) & 0xFF;
+	bno055_page[0][reg + 1] = ((uint16_t)v) >> 8;
+}
+
+// Rotates v from the world frame into the sensor frame of the unit
+// quaternion q (w, x, y, z)
+static void bno055_to_sensor(const float *q, const float *v, float *out) {
+	const float w = q[0], x = -q[1], y = -q[2], z = -q[3];
+	const float r[3][3] = {
+		{1 - 2*(y*y + z*z), 2*(x*y - z*w),     2*(x*z + y*w)},
+		{2*(x*y + z*w),     1 - 2*(x*x + z*z), 2*(y*z - x*w)},
+		{2*(x*z - y*w),     2*(y*z + x*w),     1 - 2*(x*x + y*y)}
+	};
+
+	for(uint8_t i = 0; i < 3; i++) {
+		out[i] = r[i][0]*v[0] + r[i][1]*v[1] + r[i][2]*v[2];
+	}
+}
+
+// Writes the data registers of one source for the state at time t. Units
+// are the BNO055 defaults: 1m/s² = 100LSB, 1µT = 16LSB, 1°/s = 16LSB,
+// 1° = 16LSB, quaternion 1 = 2^14LSB, 1°C = 1LSB.
+static void bno055_sample(const uint8_t source, const uint64_t t) {
+	const float seconds = t/1000000.0f;
+	const float heading = fmodf(bno055_rotation_rate*seconds, 360.0f);
+	const float roll = 10.0f*sinf(2*BNO055_PI*0.5f*seconds);
+	const float roll_rate = 10.0f*2*BNO055_PI*0.5f*cosf(2*BNO055_PI*0.5f*seconds);
+
+	const float h = heading*BNO055_PI/180.0f, r = roll*BNO055_PI/180.0f;
+	const float q[4] = {
+		cosf(h/2)*cosf(r/2),
+		cosf(h/2)*sinf(r/2),
+		sinf(h/2)*sinf(r/2),
+		sinf(h/2)*cosf(r/2)
+	};
+
+	const float gravity_world[3] = {0, 0, BNO055_GRAVITY};
+	const float field_world[3]   = {0, 20.0f, -40.0f};
+	float gravity[3], field[3];
+	bno055_to_sensor(q, gravity_world, gravity);
+	bno055_to_sensor(q, field_world, field);
+
+	const float lia[3] = {0.2f*sinf(2*BNO055_PI*2.0f*seconds), 0, 0};
+
+	if((source == BNO055_SOURCE_FUSION) || (source == BNO055_SOURCE_ACC)) {
+		if(bno055_mode_uses(bno055_mode, BNO055_SOURCE_ACC)) {
+			for(uint8_t i = 0; i < 3; i++) {
+				bno055_put(BNO055_REG_ACC_DATA + 2*i, (gravity[i] + lia[i])*100, true);
+			}
+		}
+	}
+
+	if((source == BNO055_SOURCE_FUSION) || (source == BNO055_SOURCE_MAG)) {
+		if(bno055_mode_uses(bno055_mode, BNO055_SOURCE_MAG)) {
+			for(uint8_t i = 0; i < 3; i++) {
+				bno055_put(BNO055_REG_MAG_DATA + 2*i, field[i]*16, true);
+			}
+		}
+	}
+
+	if((source == BNO055_SOURCE_FUSION) || (source == BNO055_SOURCE_GYR)) {
+		if(bno055_mode_uses(bno055_mode, BNO055_SOURCE_GYR)) {
+			bno055_put(BNO055_REG_GYR_DATA + 0, roll_rate*16, true);
+			bno055_put(BNO055_REG_GYR_DATA + 2, 0, true);
+			bno055_put(BNO055_REG_GYR_DATA + 4, bno055_rotation_rate*16, true);
+		}
+	}
+
+	if(source == BNO055_SOURCE_FUSION) {
+		bno055_put(BNO055_REG_EUL_DATA + 0, heading*16, false);
+		bno055_put(BNO055_REG_EUL_DATA + 2, roll*16, false);
+		bno055_put(BNO055_REG_EUL_DATA + 4, 0, false);
+		for(uint8_t i = 0; i < 4; i++) {
+			bno055_put(BNO055_REG_QUA_DATA + 2*i, q[i]*16384, false);
+		}
+		for(uint8_t i = 0; i < 3; i++) {
+			bno055_put(BNO055_REG_LIA_DATA + 2*i, lia[i]*100, false);
+			bno055_put(BNO055_REG_GRV_DATA + 2*i, gravity[i]*100, false);
+		}
+	}
+
+	bno055_page[0][BNO055_REG_TEMP] = (uint8_t)(int8_t)lroundf(25.0f + seconds/600.0f);
+	bno055_statistics.samples++;
+
+	switch(source) {
+		case BNO055_SOURCE_FUSION:
+		case BNO055_SOURCE_ACC: bno055_trigger_interrupt(BNO055_INT_ACC_BSX_DRDY, t); break;
+		case BNO055_SOURCE_GYR: bno055_trigger_interrupt(BNO055_INT_GYR_DRDY, t); break;
+		case BNO055_SOURCE_MAG: bno055_trigger_interrupt(BNO055_INT_MAG_DRDY, t); break;
+	}
+}
+
+void bno055_advance(const uint64_t time) {
+	while(true) {
+		BNO055Source *next = NULL;
+		uint8_t next_index = 0;
+		for(uint8_t i = 0; i < BNO055_SOURCE_NUM; i++) {
+			BNO055Source *source = &bno055_source[i];
+			if(source->enabled && (source->next <= time) && ((next == NULL) || (source->next < next->next))) {
+				next = source;
+				next_index = i;
+			}
+		}
+
+		if(next == NULL) {
+			break;
+		}
+
+		bno055_time = next->next;
+		next->next += next->period;
+		bno055_sample(next_index, bno055_time);
+	}
+
+	if(time > bno055_time) {
+		bno055_time = time;
+	}
+}
+
+// Returns the time of the next data register update, UINT64_MAX if no
+// sensor is running
+uint64_t bno055_get_next_event(void) {
+	uint64_t next = UINT64_MAX;
+	for(uint8_t i = 0; i < BNO055_SOURCE_NUM; i++) {
+		if(bno055_source[i].enabled && (bno055_source[i].next < next)) {
+			next = bno055_source[i].next;
+		}
+	}
+
+	return next;
+}
+
+static void bno055_reset(void) {
+	memset(bno055_page, 0, sizeof(bno055_page));
+
+	bno055_page[0][BNO055_REG_CHIP_ID + 0] = 0xA0;
+	bno055_page[0][BNO055_REG_CHIP_ID + 1] = 0xFB;
+	bno055_page[0][BNO055_REG_CHIP_ID + 2] = 0x32;
+	bno055_page[0][BNO055_REG_CHIP_ID + 3] = 0x0F;
+	bno055_page[0][0x04] = 0x11; // SW revision 3.11
+	bno055_page[0][0x05] = 0x03;
+	bno055_page[0][BNO055_REG_AXIS_MAP_SIGN - 1] = 0x24;
+
+	// Power on defaults of the page 1 sensor configuration
+	bno055_page[1][BNO055_REG_ACC_CONFIG]   = 0x0D; // 4G, 62.5Hz
+	bno055_page[1][BNO055_REG_MAG_CONFIG]   = 0x6D; // 20Hz
+	bno055_page[1][BNO055_REG_GYR_CONFIG_0] = 0x38; // 2000dps, 32Hz
+	for(uint8_t i = 0; i < 16; i++) {
+		bno055_page[1][0x50 + i] = 0xA0 + i; // unique id
+	}
+
+	bno055_page_id = 0;
+	bno055_mode = BNO055_MODE_CONFIG;
+	bno055_power = BNO055_POWER_NORMAL;
+	bno055_mode_ready = bno055_time;
+	bno055_set_int(false);
+	bno055_update_sources();
+}
+
+void bno055_init(void) {
+	bno055_time = 0;
+	bno055_int_handler = NULL;
+	bno055_noise = 12345;
+	bno055_rotation_rate = 30.0f;
+	memset(&bno055_statistics, 0, sizeof(bno055_statistics));
+	bno055_reset();
+}
+
+// Registers that can only be written in config mode, see 3.3 and 4.3
+static bool bno055_config_only(const uint8_t page, const uint8_t reg) {
+	if(reg == BNO055_REG_PAGE_ID) {
+		return false;
+	}
+
+	if(page == 1) {
+		return true;
+	}
+
+	return (reg == BNO055_REG_UNIT_SEL) ||
+	       (reg == BNO055_REG_PWR_MODE) ||
+	       (reg == BNO055_REG_TEMP_SOURCE) ||
+	       (reg == BNO055_REG_AXIS_MAP_SIGN - 1) ||
+	       (reg == BNO055_REG_AXIS_MAP_SIGN) ||
+	       ((reg >= BNO055_REG_OFFSET_START) && (reg <= BNO055_REG_OFFSET_END));
+}
+
+static void bno055_access(const uint64_t time) {
+	bno055_advance(time);
+	if(time < bno055_mode_ready) {
+		bno055_statistics.busy_accesses++;
+	}
+}
+
+void bno055_read(const uint8_t reg, uint8_t *data, const uint32_t length, const uint64_t time) {
+	bno055_access(time);
+	bno055_statistics.reads++;
+	bno055_statistics.bytes_read += length;
+
+	const uint8_t page = bno055_page_id;
+	for(uint32_t i = 0; i < length; i++) {
+		const uint8_t r = (reg + i) & (BNO055_PAGE_SIZE - 1);
+		data[i] = bno055_page[page][r];
+
+		// The interrupt status is cleared on read
+		if((page == 0) && (r == BNO055_REG_INT_STA)) {
+			bno055_page[0][BNO055_REG_INT_STA] = 0;
+		}
+	}
+}
+
+static void bno055_write_register(const uint8_t reg, const uint8_t value, const uint64_t time) {
+	const uint8_t page = bno055_page_id;
+
+	if(bno055_config_only(page, reg) && (bno055_mode != BNO055_MODE_CONFIG)) {
+		bno055_statistics.config_violations++;
+		return;
+	}
+
+	if(reg == BNO055_REG_PAGE_ID) {
+		bno055_page_id = value & 1;
+		bno055_page[0][BNO055_REG_PAGE_ID] = bno055_page_id;
+		bno055_page[1][BNO055_REG_PAGE_ID] = bno055_page_id;
+		return;
+	}
+
+	if(page == 1) {
+		bno055_page[1][reg] = value;
+		return;
+	}
+
+	switch(reg) {
+		case BNO055_REG_OPR_MODE: {
+			const uint8_t mode = value & 0x0F;
+			if(mode != bno055_mode) {
+				bno055_mode_ready = time + (mode == BNO055_MODE_CONFIG ? BNO055_SWITCH_TIME_CONFIG : BNO055_SWITCH_TIME_OPERATION);
+				bno055_mode = mode;
+				bno055_statistics.mode_switches++;
+			}
+			bno055_page[0][reg] = mode;
+			bno055_update_sources();
+			break;
+		}
+
+		case BNO055_REG_PWR_MODE: {
+			bno055_power = value & 3;
+			bno055_page[0][reg] = bno055_power;
+			bno055_update_sources();
+			break;
+		}
+
+		case BNO055_REG_SYS_TRIGGER: {
+			bno055_page[0][reg] = value & 0x80; // only CLK_SEL is kept
+			if(value & BNO055_SYS_TRIGGER_RST_INT) {
+				bno055_page[0][BNO055_REG_INT_STA] = 0;
+				bno055_set_int(false);
+			}
+			if(value & BNO055_SYS_TRIGGER_RST_SYS) {
+				bno055_reset();
+			}
+			break;
+		}
+
+		default: {
+			// Data and status registers are read only
+			if((reg >= BNO055_REG_ACC_DATA) && (reg <= BNO055_REG_CALIB_STAT + 5)) {
+				break;
+			}
+
+			bno055_page[0][reg] = value;
+			break;
+		}
+	}
+}
+
+void bno055_write(const uint8_t reg, const uint8_t *data, const uint32_t length, const uint64_t time) {
+	bno055_access(time);
+	bno055_statistics.writes++;
+	bno055_statistics.bytes_written += length;
+
+	for(uint32_t i = 0; i < length; i++) {
+		bno055_write_register((reg + i) & (BNO055_PAGE_SIZE - 1), data[i], time);
+	}
+}
+
+void bno055_set_int_handler(void (*handler)(void)) {
+	bno055_int_handler = handler;
+}
+
+bool bno055_get_int_level(void) {
+	return bno055_int;
+}
+
+void bno055_set_rotation_rate(const float rate) {
+	bno055_rotation_rate = rate;
+}
+
+void bno055_set_calibration_status(const uint8_t status) {
+	bno055_page[0][BNO055_REG_CALIB_STAT] = status;
+}
+
+uint8_t bno055_get_register(const uint8_t page, const uint8_t reg) {
+	return bno055_page[page & 1][reg & (BNO055_PAGE_SIZE - 1)];
+}
+
+uint8_t bno055_get_operation_mode(void) {
+	return bno055_mode;
+}
+
+uint8_t bno055_get_power_mode(void) {
+	return bno055_power;
+}
+
+const BNO055Statistics *bno055_get_statistics(void) {
+	return &bno055_statistics;
+}
+
+void bno055_reset_statistics(void) {
+	memset(&bno055_statistics, 0, sizeof(bno055_statistics));
+}
@@ -0,0 +1,124 @@
+/* imu-v2-brick
+ *
+ * bno055.h: Software model of the BNO055 for the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef BNO055_H
+#define BNO055_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The model keeps both register pages and emulates what the firmware
+// relies on: operation modes with their switch times, power modes, page 1
+// sensor and interrupt configuration, the calibration registers, the data
+// registers with the output data rates of fusion and non-fusion modes and
+// the latched INT line. The device is rotating about its z axis and rocking
+// about its x axis, so every sample differs from the previous one.
+
+#define BNO055_ADDRESS            0x29
+
+#define BNO055_PAGE_SIZE          0x80
+
+#define BNO055_REG_CHIP_ID        0x00
+#define BNO055_REG_PAGE_ID        0x07
+#define BNO055_REG_ACC_DATA       0x08
+#define BNO055_REG_MAG_DATA       0x0E
+#define BNO055_REG_GYR_DATA       0x14
+#define BNO055_REG_EUL_DATA       0x1A
+#define BNO055_REG_QUA_DATA       0x20
+#define BNO055_REG_LIA_DATA       0x28
+#define BNO055_REG_GRV_DATA       0x2E
+#define BNO055_REG_TEMP           0x34
+#define BNO055_REG_CALIB_STAT     0x35
+#define BNO055_REG_INT_STA        0x37
+#define BNO055_REG_UNIT_SEL       0x3B
+#define BNO055_REG_OPR_MODE       0x3D
+#define BNO055_REG_PWR_MODE       0x3E
+#define BNO055_REG_SYS_TRIGGER    0x3F
+#define BNO055_REG_TEMP_SOURCE    0x40
+#define BNO055_REG_AXIS_MAP_SIGN  0x42
+#define BNO055_REG_OFFSET_START   0x55
+#define BNO055_REG_OFFSET_END     0x6A
+
+// Page 1
+#define BNO055_REG_ACC_CONFIG     0x08
+#define BNO055_REG_MAG_CONFIG     0x09
+#define BNO055_REG_GYR_CONFIG_0   0x0A
+#define BNO055_REG_INT_MSK        0x0F
+#define BNO055_REG_INT_EN         0x10
+
+#define BNO055_MODE_CONFIG        0x00
+#define BNO055_MODE_ACCONLY       0x01
+#define BNO055_MODE_MAGONLY       0x02
+#define BNO055_MODE_GYROONLY      0x03
+#define BNO055_MODE_ACCMAG        0x04
+#define BNO055_MODE_ACCGYRO       0x05
+#define BNO055_MODE_MAGGYRO       0x06
+#define BNO055_MODE_AMG           0x07
+#define BNO055_MODE_IMU           0x08
+#define BNO055_MODE_COMPASS       0x09
+#define BNO055_MODE_M4G           0x0A
+#define BNO055_MODE_NDOF_FMC_OFF  0x0B
+#define BNO055_MODE_NDOF          0x0C
+
+#define BNO055_POWER_NORMAL       0
+#define BNO055_POWER_LOW_POWER    1
+#define BNO055_POWER_SUSPEND      2
+
+#define BNO055_INT_ACC_BSX_DRDY   (1 << 0)
+#define BNO055_INT_MAG_DRDY       (1 << 1)
+#define BNO055_INT_GYR_DRDY       (1 << 4)
+
+#define BNO055_SYS_TRIGGER_RST_SYS (1 << 5)
+#define BNO055_SYS_TRIGGER_RST_INT (1 << 6)
+
+#define BNO055_SWITCH_TIME_CONFIG    19000 // in µs, any mode to config mode
+#define BNO055_SWITCH_TIME_OPERATION 7000  // in µs, config mode to any mode
+#define BNO055_FUSION_PERIOD         10000 // in µs
+
+typedef struct {
+	uint32_t samples;            // data register updates
+	uint32_t reads;              // register read transfers
+	uint32_t writes;             // register write transfers
+	uint32_t bytes_read;
+	uint32_t bytes_written;
+	uint32_t config_violations;  // writes to config mode registers outside of config mode (ignored)
+	uint32_t busy_accesses;      // transfers during an operation mode switch
+	uint32_t mode_switches;
+} BNO055Statistics;
+
+void bno055_init(void);
+void bno055_advance(const uint64_t time);
+uint64_t bno055_get_next_event(void);
+void bno055_read(const uint8_t reg, uint8_t *data, const uint32_t length, const uint64_t time);
+void bno055_write(const uint8_t reg, const uint8_t *data, const uint32_t length, const uint64_t time);
+
+void bno055_set_int_handler(void (*handler)(void));
+bool bno055_get_int_level(void);
+void bno055_trigger_interrupt(const uint8_t status, const uint64_t time);
+
+void bno055_set_rotation_rate(const float rate);
+void bno055_set_calibration_status(const uint8_t status);
+uint8_t bno055_get_register(const uint8_t page, const uint8_t reg);
+uint8_t bno055_get_operation_mode(void);
+uint8_t bno055_get_power_mode(void);
+const BNO055Statistics *bno055_get_statistics(void);
+void bno055_reset_statistics(void);
+
+#endif
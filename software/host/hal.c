@@ -0,0 +1,752 @@
+/* imu-v2-brick
+ *
+ * hal.c: Host implementation of the bricklib hardware layer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "hal.h"
+
+#include "bno055.h"
+
+#include "config.h"
+#include "imu.h"
+
+#include "bricklib/com/com_common.h"
+#include "bricklib/drivers/board/sam3s/SAM3S.h"
+#include "bricklib/drivers/pio/pio.h"
+#include "bricklib/drivers/pio/pio_it.h"
+#include "bricklib/drivers/twi/twi.h"
+#include "bricklib/drivers/twi/twid.h"
+#include "bricklib/drivers/async/async.h"
+#include "bricklib/drivers/pwmc/pwmc.h"
+#include "bricklib/drivers/tc/tc.h"
+#include "bricklib/drivers/usb/USBD_HAL.h"
+#include "bricklib/drivers/flash/flashd.h"
+#include "bricklib/drivers/efc/efc.h"
+#include "bricklib/drivers/crc/crc.h"
+#include "bricklib/utility/init.h"
+#include "bricklib/utility/led.h"
+#include "bricklib/utility/mutex.h"
+#include "bricklib/free_rtos/include/FreeRTOS.h"
+#include "bricklib/free_rtos/include/task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define HAL_YIELD_TIME 10000 // in ns, the other tasks run when the tick task yields
+
+#define HAL_FLASH_LOCK_REGION_SIZE 0x1000
+#define HAL_FLASH_LOCK_REGIONS     (IFLASH_SIZE/HAL_FLASH_LOCK_REGION_SIZE)
+
+#define hal_fatal(str, ...) do { fprintf(stderr, "hal: " str "\n", ##__VA_ARGS__); abort(); } while(0)
+
+// Symbols that the firmware expects from bricklib
+Twid twid = {TWI0, NULL};
+Mutex mutex_twi_bricklet = (Mutex)&twid;
+ComInfo com_info = {COM_USB, {COM_NONE, COM_NONE}, {0, 0}, 0x3E8A1};
+bool usb_first_connection = false;
+
+SCB_Type hal_scb;
+CoreDebug_Type hal_core_debug;
+Pmc hal_pmc;
+Pio hal_pioa = {ID_PIOA};
+Pio hal_piob = {ID_PIOB};
+Tc hal_tc0;
+Pwm hal_pwm;
+Efc hal_efc;
+Twi hal_twi0 = {ID_TWI0};
+Twi hal_twi1 = {ID_TWI1};
+
+static SysTick_Type hal_systick_registers;
+static DWT_Type hal_dwt_registers;
+
+static HALStatistics hal_statistics;
+static hal_tick_listener_func_t hal_tick_listener = NULL;
+
+// Simulated time
+static uint64_t hal_time = 0; // in ns
+static uint64_t hal_next_tick = 1000000; // in ns
+static bool hal_in_tick = false;
+static bool hal_scheduler_running = false;
+static uint64_t hal_host_start = 0;
+
+// Interrupts
+static uint32_t hal_critical_depth = 0;
+static uint32_t hal_mask_depth = 0;
+static bool hal_irq_disabled = false;
+static bool hal_in_isr = false;
+static bool hal_int_pending = false;
+static bool hal_int_enabled = false;
+static const Pin *hal_int_pin = NULL;
+static void (*hal_int_handler)(const Pin *) = NULL;
+
+// TWI
+static uint32_t hal_twi_clock = HAL_TWI_CLOCK_DEFAULT;
+static uint32_t hal_twi_fail = 0;
+static bool hal_twi_mutex_taken = false;
+
+typedef struct {
+	Async *async;
+	bool read;
+	uint8_t reg;
+	uint8_t *data;
+	uint32_t length;
+	uint64_t done; // in ns
+	bool stuck;    // NACK'd, TWID never finishes it
+} HALTransfer;
+
+static HALTransfer hal_transfer;
+
+// Flash, the mapping shows the committed content, writes to it go to the
+// latch buffer on the brick. EFC commands commit the page that was written.
+static uint8_t *hal_flash = NULL;
+static uint8_t hal_flash_committed[IFLASH_SIZE];
+static bool hal_flash_locked[HAL_FLASH_LOCK_REGIONS];
+
+// LEDs and PIO
+static uint32_t hal_pio_level[2];
+static uint32_t hal_leds = 0;
+
+uint64_t hal_get_host_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec)*1000000000 + ts.tv_nsec;
+}
+
+uint64_t hal_get_time_ns(void) {
+	return hal_time;
+}
+
+uint64_t hal_get_time_us(void) {
+	return hal_time/1000;
+}
+
+static void hal_deliver_interrupt(void) {
+	if(!hal_int_pending || hal_irq_disabled || (hal_mask_depth > 0) ||
+	   (hal_critical_depth > 0) || hal_in_isr) {
+		return;
+	}
+
+	hal_int_pending = false;
+	hal_in_isr = true;
+	hal_int_handler(hal_int_pin);
+	hal_in_isr = false;
+}
+
+static void hal_int_edge(void) {
+	hal_statistics.int_edges++;
+	if(!hal_int_enabled || (hal_int_handler == NULL)) {
+		hal_statistics.int_edges_dropped++;
+		return;
+	}
+
+	hal_int_pending = true;
+	if(hal_irq_disabled || (hal_mask_depth > 0) || (hal_critical_depth > 0) || hal_in_isr) {
+		hal_statistics.int_edges_deferred++;
+		return;
+	}
+
+	hal_deliver_interrupt();
+}
+
+static void hal_complete_transfer(void);
+
+// Advances the simulated time without running the tick task. The BNO055
+// model is stepped event by event, so an INT edge is seen at its own time.
+static void hal_advance(const uint64_t time) {
+	if((hal_transfer.async != NULL) && !hal_transfer.stuck && (hal_transfer.done <= time)) {
+		hal_complete_transfer();
+	}
+
+	while(true) {
+		const uint64_t next = bno055_get_next_event();
+		if((next == UINT64_MAX) || (next*1000 > time)) {
+			break;
+		}
+
+		if(next*1000 > hal_time) {
+			hal_time = next*1000;
+		}
+		bno055_advance(next);
+	}
+
+	if(time > hal_time) {
+		hal_time = time;
+	}
+	bno055_advance(hal_time/1000);
+}
+
+static void hal_run_tick(void) {
+	hal_in_tick = true;
+	for(uint8_t tick_type = TICK_TASK_TYPE_CALCULATION; tick_type <= TICK_TASK_TYPE_MESSAGE; tick_type++) {
+		const uint64_t start = hal_get_host_ns();
+		tick_task(tick_type);
+		const uint64_t ns = hal_get_host_ns() - start;
+
+		if(hal_critical_depth != 0) {
+			hal_fatal("tick task %d left a critical section open", tick_type);
+		}
+		if(hal_twi_mutex_taken) {
+			hal_fatal("tick task %d left the TWI mutex taken", tick_type);
+		}
+
+		if(hal_tick_listener != NULL) {
+			hal_tick_listener(tick_type, ns);
+		}
+	}
+	hal_in_tick = false;
+	hal_statistics.ticks++;
+}
+
+void hal_run_until(const uint64_t time_us) {
+	if(hal_in_tick || hal_in_isr) {
+		hal_fatal("scheduler called from a tick or an interrupt");
+	}
+	if(!hal_scheduler_running) {
+		hal_fatal("scheduler not started");
+	}
+
+	const uint64_t time = time_us*1000;
+	while(hal_next_tick <= time) {
+		hal_advance(hal_next_tick);
+		hal_next_tick += 1000000;
+		hal_run_tick();
+	}
+
+	hal_advance(time);
+}
+
+void hal_run_ms(const uint32_t ms) {
+	hal_run_until(hal_get_time_us() + ms*1000);
+}
+
+// The tick task is started after imu_init, as in main of the brick
+void hal_start_scheduler(void) {
+	hal_scheduler_running = true;
+	hal_next_tick = (hal_time/1000000 + 1)*1000000;
+}
+
+void hal_set_tick_listener(hal_tick_listener_func_t listener) {
+	hal_tick_listener = listener;
+}
+
+const HALStatistics *hal_get_statistics(void) {
+	return &hal_statistics;
+}
+
+void hal_reset_statistics(void) {
+	memset(&hal_statistics, 0, sizeof(HALStatistics));
+}
+
+static void hal_bno_int(void) {
+	hal_int_edge();
+}
+
+void hal_init(void) {
+	if(hal_flash == NULL) {
+		hal_flash = mmap((void *)IFLASH_ADDR, IFLASH_SIZE,
+		                 PROT_READ | PROT_WRITE,
+		                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+		                 -1, 0);
+		if(hal_flash != (uint8_t *)IFLASH_ADDR) {
+			hal_fatal("could not map the flash at 0x%08X", IFLASH_ADDR);
+		}
+	}
+
+	memset(hal_flash, 0xFF, IFLASH_SIZE);
+	memset(hal_flash_committed, 0xFF, IFLASH_SIZE);
+	for(uint32_t i = 0; i < HAL_FLASH_LOCK_REGIONS; i++) {
+		hal_flash_locked[i] = true;
+	}
+
+	hal_time = 0;
+	hal_next_tick = 1000000;
+	hal_scheduler_running = false;
+	hal_host_start = hal_get_host_ns();
+	memset(&hal_transfer, 0, sizeof(HALTransfer));
+	hal_reset_statistics();
+
+	hal_systick_registers.LOAD = BOARD_MCK/1000 - 1;
+	hal_scb.ICSR = 0;
+
+	bno055_init();
+	bno055_set_int_handler(hal_bno_int);
+}
+
+// FreeRTOS
+portTickType xTaskGetTickCount(void) {
+	return hal_time/1000000;
+}
+
+portTickType xTaskGetTickCountFromISR(void) {
+	return hal_time/1000000;
+}
+
+// Wakes up with the tick interrupt, like vTaskDelay on the brick
+void vTaskDelay(const portTickType ticks) {
+	if(hal_in_isr || (hal_critical_depth > 0)) {
+		hal_fatal("vTaskDelay in an interrupt or a critical section");
+	}
+
+	const uint64_t wake = (hal_time/1000000 + ticks)*1000000;
+	if(hal_in_tick || !hal_scheduler_running) {
+		hal_advance(wake);
+	} else {
+		hal_run_until(wake/1000);
+	}
+}
+
+void hal_critical_enter(void) {
+	hal_critical_depth++;
+	if(hal_critical_depth > hal_statistics.critical_max_depth) {
+		hal_statistics.critical_max_depth = hal_critical_depth;
+	}
+}
+
+void hal_critical_exit(void) {
+	if(hal_critical_depth == 0) {
+		hal_fatal("taskEXIT_CRITICAL without taskENTER_CRITICAL");
+	}
+
+	hal_critical_depth--;
+	hal_deliver_interrupt();
+}
+
+unsigned portBASE_TYPE hal_interrupt_mask_set(void) {
+	hal_mask_depth++;
+	return hal_mask_depth - 1;
+}
+
+void hal_interrupt_mask_clear(unsigned portBASE_TYPE mask) {
+	hal_mask_depth = mask;
+	hal_deliver_interrupt();
+}
+
+void hal_yield(void) {
+	if(hal_transfer.stuck) {
+		hal_advance(hal_time + HAL_YIELD_TIME);
+	} else if(hal_transfer.async != NULL) {
+		hal_advance(hal_transfer.done);
+	}
+}
+
+// Core peripherals
+SysTick_Type *hal_systick(void) {
+	// Counts down from LOAD once per ms, the tick count is always up to
+	// date, so PENDSTSET is never set
+	const uint64_t ns_in_tick = hal_time % 1000000;
+	hal_systick_registers.VAL = hal_systick_registers.LOAD - ns_in_tick*(BOARD_MCK/1000000)/1000;
+	return &hal_systick_registers;
+}
+
+// The cycle counter shows the host CPU time scaled to the core clock, the
+// profiling of the firmware measures the host
+DWT_Type *hal_dwt(void) {
+	hal_dwt_registers.CYCCNT = (uint32_t)((hal_get_host_ns() - hal_host_start)*(BOARD_MCK/1000000)/1000);
+	return &hal_dwt_registers;
+}
+
+void NVIC_SetPriority(const IRQn_Type irq, const uint32_t priority) {
+	(void)irq;
+	(void)priority;
+}
+
+void NVIC_EnableIRQ(const IRQn_Type irq) {
+	(void)irq;
+}
+
+void __disable_irq(void) {
+	hal_irq_disabled = true;
+}
+
+void __enable_irq(void) {
+	hal_irq_disabled = false;
+	hal_deliver_interrupt();
+}
+
+void __DMB(void) {
+	__sync_synchronize();
+}
+
+// TWI, only the BNO055 is on the bus
+static uint64_t hal_twi_duration(const uint32_t length, const bool read) {
+	// Start, address and register byte, repeated start and address for a
+	// read, 9 clocks per byte including the (N)ACK
+	const uint32_t bytes = length + (read ? 3 : 2);
+	return ((uint64_t)bytes)*9*1000000000/hal_twi_clock;
+}
+
+static uint8_t hal_twi_access(const bool read, const uint8_t reg, uint8_t *data, const uint32_t length) {
+	hal_statistics.twi_transfers++;
+	if(hal_twi_fail > 0) {
+		hal_twi_fail--;
+		hal_statistics.twi_errors++;
+		return TWID_ERROR_NACK;
+	}
+
+	hal_statistics.twi_bytes += length;
+	if(read) {
+		bno055_read(reg, data, length, hal_time/1000);
+	} else {
+		bno055_write(reg, data, length, hal_time/1000);
+	}
+
+	return 0;
+}
+
+static void hal_complete_transfer(void) {
+	HALTransfer transfer = hal_transfer;
+	memset(&hal_transfer, 0, sizeof(HALTransfer));
+
+	if(transfer.done > hal_time) {
+		hal_time = transfer.done;
+	}
+
+	// The TWID handler only finishes a transfer on TXCOMP, after a NACK
+	// it stays pending until it is stopped
+	if(hal_twi_access(transfer.read, transfer.reg, transfer.data, transfer.length) != 0) {
+		transfer.stuck = true;
+		hal_transfer = transfer;
+		return;
+	}
+
+	transfer.async->status = 0;
+	if(transfer.async->callback != NULL) {
+		transfer.async->callback(transfer.async->pArgument);
+	}
+}
+
+static uint8_t hal_twi_transfer(Twid *pTwid, const bool read, const uint8_t address, const uint32_t iaddress, uint8_t *pData, const uint32_t num, Async *pAsync) {
+	if(pTwid->pTwi != TWI0) {
+		hal_fatal("TWI transfer on an unknown bus");
+	}
+	if(!hal_twi_mutex_taken) {
+		hal_fatal("TWI transfer without the TWI mutex");
+	}
+	if(hal_transfer.async != NULL) {
+		return TWID_ERROR_BUSY;
+	}
+	if(address != BNO055_ADDRESS) {
+		hal_statistics.twi_errors++;
+		return TWID_ERROR_NACK;
+	}
+
+	const uint64_t duration = hal_twi_duration(num, read);
+	hal_statistics.twi_busy_ns += duration;
+
+	if(pAsync != NULL) {
+		pAsync->status = ASYNC_STATUS_PENDING;
+		hal_transfer.async  = pAsync;
+		hal_transfer.read   = read;
+		hal_transfer.reg    = iaddress;
+		hal_transfer.data   = pData;
+		hal_transfer.length = num;
+		hal_transfer.done   = hal_time + duration;
+		return 0;
+	}
+
+	// Synchronous transfers busy wait on the TWI status register
+	hal_advance(hal_time + duration);
+	return hal_twi_access(read, iaddress, pData, num);
+}
+
+uint8_t TWID_Read(Twid *pTwid, uint8_t address, uint32_t iaddress, uint8_t isize, uint8_t *pData, uint32_t num, Async *pAsync) {
+	(void)isize;
+	return hal_twi_transfer(pTwid, true, address, iaddress, pData, num, pAsync);
+}
+
+uint8_t TWID_Write(Twid *pTwid, uint8_t address, uint32_t iaddress, uint8_t isize, uint8_t *pData, uint32_t num, Async *pAsync) {
+	(void)isize;
+	return hal_twi_transfer(pTwid, false, address, iaddress, pData, num, pAsync);
+}
+
+void TWID_Handler(Twid *pTwid) {
+	(void)pTwid;
+}
+
+void TWI_DisableIt(Twi *pTwi, uint32_t sources) {
+	(void)pTwi;
+	(void)sources;
+}
+
+void TWI_Stop(Twi *pTwi) {
+	if(pTwi != TWI0) {
+		hal_fatal("TWI stop on an unknown bus");
+	}
+
+	if(hal_transfer.async != NULL) {
+		memset(&hal_transfer, 0, sizeof(HALTransfer));
+		hal_statistics.twi_aborts++;
+	}
+}
+
+uint8_t ASYNC_IsFinished(Async *pAsync) {
+	return pAsync->status != ASYNC_STATUS_PENDING;
+}
+
+void hal_twi_set_clock(const uint32_t hz) {
+	hal_twi_clock = hz;
+}
+
+void hal_twi_fail_next(const uint32_t transfers) {
+	hal_twi_fail = transfers;
+}
+
+// Mutex, there is only one task that can hold it at a time on the host,
+// taking it twice would dead lock on the brick
+bool mutex_take(Mutex mutex, const uint32_t time) {
+	(void)time;
+	if(mutex != mutex_twi_bricklet) {
+		hal_fatal("unknown mutex");
+	}
+	if(hal_twi_mutex_taken) {
+		hal_fatal("TWI mutex taken twice");
+	}
+
+	hal_twi_mutex_taken = true;
+	return true;
+}
+
+bool mutex_give(Mutex mutex) {
+	if(mutex != mutex_twi_bricklet) {
+		hal_fatal("unknown mutex");
+	}
+	if(!hal_twi_mutex_taken) {
+		hal_fatal("TWI mutex given without being taken");
+	}
+
+	hal_twi_mutex_taken = false;
+	return true;
+}
+
+// PIO
+static uint32_t *hal_pio_get_level(const Pin *pin) {
+	return &hal_pio_level[pin->pio == PIOB ? 1 : 0];
+}
+
+uint8_t PIO_Configure(const Pin *list, uint32_t size) {
+	for(uint32_t i = 0; i < size; i++) {
+		if(list[i].type == PIO_OUTPUT_1) {
+			*hal_pio_get_level(&list[i]) |= list[i].mask;
+		} else if(list[i].type == PIO_OUTPUT_0) {
+			*hal_pio_get_level(&list[i]) &= ~list[i].mask;
+		}
+	}
+
+	return 1;
+}
+
+void PIO_Set(const Pin *pin) {
+	*hal_pio_get_level(pin) |= pin->mask;
+}
+
+void PIO_Clear(const Pin *pin) {
+	*hal_pio_get_level(pin) &= ~pin->mask;
+}
+
+uint8_t PIO_Get(const Pin *pin) {
+	if((hal_int_pin != NULL) && (pin->pio == hal_int_pin->pio) && (pin->mask == hal_int_pin->mask)) {
+		return bno055_get_int_level();
+	}
+
+	return (*hal_pio_get_level(pin) & pin->mask) != 0;
+}
+
+void PIO_InitializeInterrupts(uint32_t priority) {
+	(void)priority;
+}
+
+void PIO_ConfigureIt(const Pin *pPin, void (*handler)(const Pin *)) {
+	hal_int_pin = pPin;
+	hal_int_handler = handler;
+}
+
+// Enabling the interrupt clears the edges seen while it was disabled, as
+// PIO_EnableIt does by reading PIO_ISR
+void PIO_EnableIt(const Pin *pPin) {
+	(void)pPin;
+	hal_int_pending = false;
+	hal_int_enabled = true;
+}
+
+void PIO_DisableIt(const Pin *pPin) {
+	(void)pPin;
+	hal_int_enabled = false;
+}
+
+// PWM and TC, only the values are kept
+void PWMC_ConfigureChannel(Pwm *pwm, uint8_t channel, uint32_t prescaler, uint32_t alignment, uint32_t polarity) {
+	(void)pwm;
+	(void)channel;
+	(void)prescaler;
+	(void)alignment;
+	(void)polarity;
+}
+
+void PWMC_SetPeriod(Pwm *pwm, uint8_t channel, uint16_t period) {
+	pwm->period[channel & 3] = period;
+}
+
+void PWMC_SetDutyCycle(Pwm *pwm, uint8_t channel, uint16_t duty) {
+	pwm->duty[channel & 3] = duty;
+}
+
+void PWMC_EnableChannel(Pwm *pwm, uint8_t channel) {
+	pwm->enabled |= 1 << channel;
+}
+
+void tc_channel_init(TcChannel *channel, const uint32_t mode) {
+	channel->TC_CMR = mode;
+}
+
+void tc_channel_start(TcChannel *channel) {
+	(void)channel;
+}
+
+void tc_channel_stop(TcChannel *channel) {
+	(void)channel;
+}
+
+void led_on(const uint8_t led) {
+	hal_leds |= 1 << led;
+}
+
+void led_off(const uint8_t led) {
+	hal_leds &= ~(1 << led);
+}
+
+// Flash
+static bool hal_flash_unlocked(const uint32_t start, const uint32_t end) {
+	for(uint32_t address = start; address < end; address += HAL_FLASH_LOCK_REGION_SIZE) {
+		if(hal_flash_locked[(address - IFLASH_ADDR)/HAL_FLASH_LOCK_REGION_SIZE]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static uint8_t hal_flash_set_lock(uint32_t start, uint32_t end, const bool lock) {
+	if((start < IFLASH_ADDR) || (end > IFLASH_ADDR + IFLASH_SIZE) || (start >= end)) {
+		hal_statistics.flash_errors++;
+		return 1;
+	}
+
+	for(uint32_t region = (start - IFLASH_ADDR)/HAL_FLASH_LOCK_REGION_SIZE;
+	    region <= (end - 1 - IFLASH_ADDR)/HAL_FLASH_LOCK_REGION_SIZE;
+	    region++) {
+		hal_flash_locked[region] = lock;
+	}
+
+	return 0;
+}
+
+uint8_t FLASHD_Unlock(uint32_t start, uint32_t end, uint32_t *pActualStart, uint32_t *pActualEnd) {
+	(void)pActualStart;
+	(void)pActualEnd;
+	return hal_flash_set_lock(start, end, false);
+}
+
+uint8_t FLASHD_Lock(uint32_t start, uint32_t end, uint32_t *pActualStart, uint32_t *pActualEnd) {
+	(void)pActualStart;
+	(void)pActualEnd;
+	return hal_flash_set_lock(start, end, true);
+}
+
+// Erases and writes every page that is touched
+uint8_t FLASHD_Write(uint32_t address, const void *pBuffer, uint32_t size) {
+	hal_statistics.flash_commands++;
+	if((address < IFLASH_ADDR) || (address + size > IFLASH_ADDR + IFLASH_SIZE) ||
+	   !hal_flash_unlocked(address, address + size)) {
+		hal_statistics.flash_errors++;
+		return 1;
+	}
+
+	const uint32_t offset = address - IFLASH_ADDR;
+	memcpy(&hal_flash_committed[offset], pBuffer, size);
+
+	const uint32_t page_start = offset - offset % IFLASH_PAGE_SIZE;
+	const uint32_t page_end = ((offset + size + IFLASH_PAGE_SIZE - 1)/IFLASH_PAGE_SIZE)*IFLASH_PAGE_SIZE;
+	memcpy(&hal_flash[page_start], &hal_flash_committed[page_start], page_end - page_start);
+
+	return 0;
+}
+
+// Write page clears the bits that are 0 in the latch buffer, erase and
+// write page replaces the page with the latch buffer
+uint32_t EFC_PerformCommand(Efc *efc, uint32_t command, uint32_t argument, uint32_t useIAP) {
+	(void)efc;
+	(void)useIAP;
+	hal_statistics.flash_commands++;
+
+	if((command != EFC_FCMD_WP) && (command != EFC_FCMD_EWP)) {
+		hal_statistics.flash_errors++;
+		return 1;
+	}
+
+	const uint32_t offset = argument*IFLASH_PAGE_SIZE;
+	if((offset >= IFLASH_SIZE) || !hal_flash_unlocked(IFLASH_ADDR + offset, IFLASH_ADDR + offset + IFLASH_PAGE_SIZE)) {
+		hal_statistics.flash_errors++;
+		return 1;
+	}
+
+	for(uint32_t i = offset; i < offset + IFLASH_PAGE_SIZE; i++) {
+		if(command == EFC_FCMD_WP) {
+			hal_flash_committed[i] &= hal_flash[i];
+		} else {
+			hal_flash_committed[i] = hal_flash[i];
+		}
+		hal_flash[i] = hal_flash_committed[i];
+	}
+
+	return 0;
+}
+
+// Returns false if the flash was written without a flash command
+bool hal_flash_verify(void) {
+	return memcmp(hal_flash, hal_flash_committed, IFLASH_SIZE) == 0;
+}
+
+const uint8_t *hal_flash_get(const uint32_t address) {
+	return &hal_flash_committed[address - IFLASH_ADDR];
+}
+
+// Misc
+uint16_t crc16(const uint8_t *data, const uint16_t length) {
+	uint16_t crc = 0xFFFF;
+	for(uint16_t i = 0; i < length; i++) {
+		crc ^= data[i];
+		for(uint8_t j = 0; j < 8; j++) {
+			crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+		}
+	}
+
+	return crc;
+}
+
+bool usbd_hal_is_disabled(const uint8_t endpoint) {
+	(void)endpoint;
+	return true;
+}
+
+bool brick_init_enumeration(const ComType com) {
+	(void)com;
+	return true;
+}
@@ -0,0 +1,75 @@
+/* imu-v2-brick
+ *
+ * hal.h: Host implementation of the bricklib hardware layer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The firmware runs single threaded on the host against a simulated clock.
+// Time only advances through the scheduler (hal_run_*, vTaskDelay) and
+// through the bus time of TWI transfers. After hal_start_scheduler the
+// tick task is called once per simulated ms, a tick that takes longer
+// makes the following ticks run back to back, as with vTaskDelayUntil on
+// the brick. A vTaskDelay outside of a tick (in a message handler) lets the
+// tick task run in between.
+
+#define HAL_TWI_CLOCK_DEFAULT 400000 // in Hz
+
+typedef struct {
+	uint32_t ticks;
+	uint32_t twi_transfers;
+	uint32_t twi_bytes;
+	uint32_t twi_errors;
+	uint32_t twi_aborts;          // transfers stopped with TWI_Stop
+	uint64_t twi_busy_ns;
+	uint32_t int_edges;
+	uint32_t int_edges_dropped;   // edges while the PIO interrupt was disabled
+	uint32_t int_edges_deferred;  // edges while interrupts were masked
+	uint32_t flash_commands;
+	uint32_t flash_errors;
+	uint32_t critical_max_depth;
+} HALStatistics;
+
+typedef void (*hal_tick_listener_func_t)(const uint8_t tick_type, const uint64_t host_ns);
+
+void hal_init(void);
+void hal_start_scheduler(void);
+
+uint64_t hal_get_time_ns(void);
+uint64_t hal_get_time_us(void);
+uint64_t hal_get_host_ns(void);
+
+void hal_run_until(const uint64_t time_us);
+void hal_run_ms(const uint32_t ms);
+
+void hal_twi_set_clock(const uint32_t hz);
+void hal_twi_fail_next(const uint32_t transfers);
+
+bool hal_flash_verify(void);
+const uint8_t *hal_flash_get(const uint32_t address);
+
+void hal_set_tick_listener(hal_tick_listener_func_t listener);
+
+const HALStatistics *hal_get_statistics(void);
+void hal_reset_statistics(void);
+
+#endif
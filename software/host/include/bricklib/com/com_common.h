@@ -0,0 +1,74 @@
+/* imu-v2-brick
+ *
+ * com_common.h: Host replacement for the common com definitions, see transport.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_COM_COM_COMMON_H
+#define HOST_COM_COM_COMMON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define COM_NONE      0
+#define COM_USB       1
+#define COM_SPI_STACK 2
+#define COM_RS485     3
+#define COM_WIFI      4
+#define COM_ETHERNET  5
+
+typedef uint8_t ComType;
+
+typedef struct {
+	ComType current;
+	ComType ext[2];
+	uint8_t ext_type[2];
+	uint32_t uid;
+} ComInfo;
+
+typedef struct {
+	uint32_t uid;
+	uint8_t length;
+	uint8_t fid;
+	uint8_t other_options:2,
+	        authentication:1,
+	        return_expected:1,
+	        sequence_num:4;
+	uint8_t future_use:6,
+	        error:2;
+} __attribute__((__packed__)) MessageHeader;
+
+#define MESSAGE_ERROR_CODE_OK                0
+#define MESSAGE_ERROR_CODE_INVALID_PARAMETER 1
+#define MESSAGE_ERROR_CODE_NOT_SUPPORTED     2
+
+#define TICK_TASK_TYPE_CALCULATION 0
+#define TICK_TASK_TYPE_MESSAGE     1
+
+typedef void (*message_handler_func_t)(const ComType com, const void *data);
+
+typedef struct {
+	uint8_t fid;
+	message_handler_func_t reply_func;
+} ComMessage;
+
+uint16_t send_blocking_with_timeout(const void *data, const uint16_t length, ComType com);
+void com_make_default_header(void *data, const uint32_t uid, const uint8_t length, const uint8_t fid);
+void com_return_setter(const ComType com, const void *data);
+void com_return_error(const void *data, const uint8_t ret_length, const uint8_t error_code, const ComType com);
+
+#endif
@@ -0,0 +1,36 @@
+/* imu-v2-brick
+ *
+ * async.h: Host replacement for asynchronous transfer descriptors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_ASYNC_ASYNC_H
+#define HOST_DRIVERS_ASYNC_ASYNC_H
+
+#include <stdint.h>
+
+#define ASYNC_STATUS_PENDING 0xFF
+
+typedef struct {
+	volatile uint8_t status;
+	void (*callback)(void *);
+	void *pArgument;
+} Async;
+
+uint8_t ASYNC_IsFinished(Async *pAsync);
+
+#endif
@@ -0,0 +1,137 @@
+/* imu-v2-brick
+ *
+ * SAM3S.h: Host replacement for the SAM3S device and Cortex-M3 core header
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_BOARD_SAM3S_SAM3S_H
+#define HOST_DRIVERS_BOARD_SAM3S_SAM3S_H
+
+#include <stdint.h>
+
+// Core peripherals. The host HAL keeps SysTick and DWT in sync with the
+// simulated time and the host clock when they are accessed.
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+	volatile uint32_t ICSR;
+} SCB_Type;
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+SysTick_Type *hal_systick(void);
+DWT_Type *hal_dwt(void);
+extern SCB_Type hal_scb;
+extern CoreDebug_Type hal_core_debug;
+
+#define SysTick   (hal_systick())
+#define DWT       (hal_dwt())
+#define SCB       (&hal_scb)
+#define CoreDebug (&hal_core_debug)
+
+#define SCB_ICSR_PENDSTSET_Msk     (1UL << 26)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+
+typedef enum {
+	TWI0_IRQn = 19,
+	TWI1_IRQn = 20
+} IRQn_Type;
+
+void NVIC_SetPriority(const IRQn_Type irq, const uint32_t priority);
+void NVIC_EnableIRQ(const IRQn_Type irq);
+void __disable_irq(void);
+void __enable_irq(void);
+void __DMB(void);
+
+// Peripherals
+typedef struct {
+	volatile uint32_t PMC_PCER0;
+} Pmc;
+
+typedef struct {
+	uint32_t id;
+} Pio;
+
+typedef struct {
+	volatile uint32_t TC_CMR;
+	volatile uint32_t TC_RA;
+	volatile uint32_t TC_RB;
+	volatile uint32_t TC_RC;
+} TcChannel;
+
+typedef struct {
+	TcChannel TC_CHANNEL[3];
+} Tc;
+
+typedef struct {
+	volatile uint32_t duty[4];
+	volatile uint32_t period[4];
+	volatile uint32_t enabled;
+} Pwm;
+
+typedef struct {
+	uint32_t id;
+} Efc;
+
+extern Pmc hal_pmc;
+extern Pio hal_pioa;
+extern Pio hal_piob;
+extern Tc hal_tc0;
+extern Pwm hal_pwm;
+extern Efc hal_efc;
+
+#define PMC  (&hal_pmc)
+#define PIOA (&hal_pioa)
+#define PIOB (&hal_piob)
+#define TC0  (&hal_tc0)
+#define PWM  (&hal_pwm)
+#define EFC  (&hal_efc)
+
+#define ID_PIOA 11
+#define ID_PIOB 12
+#define ID_TWI0 19
+#define ID_TWI1 20
+#define ID_TC0  23
+#define ID_TC1  24
+#define ID_TC2  25
+#define ID_PWM  31
+
+// The flash is emulated in a host mapping at a fixed address below 4GB,
+// the firmware keeps flash addresses in uint32_t
+#define IFLASH_ADDR      0x10000000
+#define IFLASH_SIZE      0x20000
+#define IFLASH_PAGE_SIZE 256
+
+#define END_OF_BRICKLET_MEMORY (IFLASH_ADDR + IFLASH_SIZE)
+
+// The board header of bricklib provides the PIO types as well
+#include "bricklib/drivers/pio/pio.h"
+
+#endif
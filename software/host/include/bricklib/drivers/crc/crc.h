@@ -0,0 +1,28 @@
+/* imu-v2-brick
+ *
+ * crc.h: Host replacement for the CRC functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_CRC_CRC_H
+#define HOST_DRIVERS_CRC_CRC_H
+
+#include <stdint.h>
+
+uint16_t crc16(const uint8_t *data, const uint16_t length);
+
+#endif
@@ -0,0 +1,39 @@
+/* imu-v2-brick
+ *
+ * efc.h: Host replacement for the enhanced embedded flash controller driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_EFC_EFC_H
+#define HOST_DRIVERS_EFC_EFC_H
+
+#include <stdint.h>
+
+#include "bricklib/drivers/board/sam3s/SAM3S.h"
+
+#define EFC_FCMD_GETD 0x00
+#define EFC_FCMD_WP   0x01
+#define EFC_FCMD_WPL  0x02
+#define EFC_FCMD_EWP  0x03
+#define EFC_FCMD_EWPL 0x04
+#define EFC_FCMD_EA   0x05
+#define EFC_FCMD_SLB  0x08
+#define EFC_FCMD_CLB  0x09
+
+uint32_t EFC_PerformCommand(Efc *efc, uint32_t command, uint32_t argument, uint32_t useIAP);
+
+#endif
@@ -0,0 +1,30 @@
+/* imu-v2-brick
+ *
+ * flashd.h: Host replacement for the flash driver, works on the emulated flash
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_FLASH_FLASHD_H
+#define HOST_DRIVERS_FLASH_FLASHD_H
+
+#include <stdint.h>
+
+uint8_t FLASHD_Write(uint32_t address, const void *pBuffer, uint32_t size);
+uint8_t FLASHD_Unlock(uint32_t start, uint32_t end, uint32_t *pActualStart, uint32_t *pActualEnd);
+uint8_t FLASHD_Lock(uint32_t start, uint32_t end, uint32_t *pActualStart, uint32_t *pActualEnd);
+
+#endif
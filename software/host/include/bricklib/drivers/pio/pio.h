@@ -0,0 +1,57 @@
+/* imu-v2-brick
+ *
+ * pio.h: Host replacement for the PIO driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_PIO_PIO_H
+#define HOST_DRIVERS_PIO_PIO_H
+
+#include <stdint.h>
+
+#include "bricklib/drivers/board/sam3s/SAM3S.h"
+
+#define PIO_PERIPH_A 0
+#define PIO_PERIPH_B 1
+#define PIO_PERIPH_C 2
+#define PIO_INPUT    3
+#define PIO_OUTPUT_0 4
+#define PIO_OUTPUT_1 5
+
+#define PIO_DEFAULT      (0 << 0)
+#define PIO_PULLUP       (1 << 0)
+#define PIO_DEGLITCH     (1 << 1)
+#define PIO_OPENDRAIN    (1 << 2)
+#define PIO_IT_RISE_EDGE (1 << 6)
+#define PIO_IT_FALL_EDGE (1 << 7)
+
+#define PIO_LISTSIZE(pPins) (sizeof(pPins) / sizeof(Pin))
+
+typedef struct {
+	uint32_t mask;
+	Pio *pio;
+	uint8_t id;
+	uint8_t type;
+	uint8_t attribute;
+} Pin;
+
+uint8_t PIO_Configure(const Pin *list, uint32_t size);
+void PIO_Set(const Pin *pin);
+void PIO_Clear(const Pin *pin);
+uint8_t PIO_Get(const Pin *pin);
+
+#endif
@@ -0,0 +1,35 @@
+/* imu-v2-brick
+ *
+ * pwmc.h: Host replacement for the PWM driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_PWMC_PWMC_H
+#define HOST_DRIVERS_PWMC_PWMC_H
+
+#include <stdint.h>
+
+#include "bricklib/drivers/board/sam3s/SAM3S.h"
+
+#define PWM_CMR_CPRE_MCK 0
+
+void PWMC_ConfigureChannel(Pwm *pwm, uint8_t channel, uint32_t prescaler, uint32_t alignment, uint32_t polarity);
+void PWMC_SetPeriod(Pwm *pwm, uint8_t channel, uint16_t period);
+void PWMC_SetDutyCycle(Pwm *pwm, uint8_t channel, uint16_t duty);
+void PWMC_EnableChannel(Pwm *pwm, uint8_t channel);
+
+#endif
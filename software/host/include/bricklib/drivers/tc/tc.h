@@ -0,0 +1,41 @@
+/* imu-v2-brick
+ *
+ * tc.h: Host replacement for the timer counter driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_TC_TC_H
+#define HOST_DRIVERS_TC_TC_H
+
+#include <stdint.h>
+
+#include "bricklib/drivers/board/sam3s/SAM3S.h"
+
+#define TC_CMR_TCCLKS_TIMER_CLOCK1 (0 << 0)
+#define TC_CMR_EEVT_XC0            (1 << 10)
+#define TC_CMR_WAVSEL_UP_RC        (2 << 13)
+#define TC_CMR_WAVE                (1 << 15)
+#define TC_CMR_ACPA_CLEAR          (2 << 16)
+#define TC_CMR_ACPC_SET            (1 << 18)
+#define TC_CMR_BCPB_CLEAR          (2 << 24)
+#define TC_CMR_BCPC_SET            (1 << 26)
+
+void tc_channel_init(TcChannel *channel, const uint32_t mode);
+void tc_channel_start(TcChannel *channel);
+void tc_channel_stop(TcChannel *channel);
+
+#endif
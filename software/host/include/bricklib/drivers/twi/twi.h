@@ -0,0 +1,43 @@
+/* imu-v2-brick
+ *
+ * twi.h: Host replacement for the TWI peripheral driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_TWI_TWI_H
+#define HOST_DRIVERS_TWI_TWI_H
+
+#include <stdint.h>
+
+typedef struct {
+	uint32_t id;
+} Twi;
+
+extern Twi hal_twi0;
+extern Twi hal_twi1;
+
+#define TWI0 (&hal_twi0)
+#define TWI1 (&hal_twi1)
+
+#define TWI_IDR_TXCOMP (1 << 0)
+#define TWI_IDR_RXRDY  (1 << 1)
+#define TWI_IDR_TXRDY  (1 << 2)
+
+void TWI_DisableIt(Twi *pTwi, uint32_t sources);
+void TWI_Stop(Twi *pTwi);
+
+#endif
@@ -0,0 +1,41 @@
+/* imu-v2-brick
+ *
+ * twid.h: Host replacement for the TWI driver, transfers go to the BNO055 model
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_TWI_TWID_H
+#define HOST_DRIVERS_TWI_TWID_H
+
+#include <stdint.h>
+
+#include "bricklib/drivers/twi/twi.h"
+#include "bricklib/drivers/async/async.h"
+
+#define TWID_ERROR_BUSY 1
+#define TWID_ERROR_NACK 2
+
+typedef struct {
+	Twi *pTwi;
+	Async *pTransfer;
+} Twid;
+
+uint8_t TWID_Read(Twid *pTwid, uint8_t address, uint32_t iaddress, uint8_t isize, uint8_t *pData, uint32_t num, Async *pAsync);
+uint8_t TWID_Write(Twid *pTwid, uint8_t address, uint32_t iaddress, uint8_t isize, uint8_t *pData, uint32_t num, Async *pAsync);
+void TWID_Handler(Twid *pTwid);
+
+#endif
@@ -0,0 +1,31 @@
+/* imu-v2-brick
+ *
+ * USBD_HAL.h: Host replacement for the USB device HAL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_DRIVERS_USB_USBD_HAL_H
+#define HOST_DRIVERS_USB_USBD_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IN_EP 4
+
+bool usbd_hal_is_disabled(const uint8_t endpoint);
+
+#endif
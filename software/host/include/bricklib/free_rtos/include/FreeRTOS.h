@@ -0,0 +1,37 @@
+/* imu-v2-brick
+ *
+ * FreeRTOS.h: Host replacement for the FreeRTOS configuration and port types
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_FREE_RTOS_INCLUDE_FREERTOS_H
+#define HOST_FREE_RTOS_INCLUDE_FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t portTickType;
+#define portBASE_TYPE long
+
+#define portTICK_RATE_MS ((portTickType)1)
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()      hal_interrupt_mask_set()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)   hal_interrupt_mask_clear(x)
+
+unsigned portBASE_TYPE hal_interrupt_mask_set(void);
+void hal_interrupt_mask_clear(unsigned portBASE_TYPE mask);
+
+#endif
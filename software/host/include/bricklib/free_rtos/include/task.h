@@ -0,0 +1,40 @@
+/* imu-v2-brick
+ *
+ * task.h: Host replacement for the FreeRTOS task API, the scheduler is the simulation loop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_FREE_RTOS_INCLUDE_TASK_H
+#define HOST_FREE_RTOS_INCLUDE_TASK_H
+
+#include "bricklib/free_rtos/include/FreeRTOS.h"
+
+typedef void *xTaskHandle;
+
+portTickType xTaskGetTickCount(void);
+portTickType xTaskGetTickCountFromISR(void);
+void vTaskDelay(const portTickType ticks);
+
+void hal_critical_enter(void);
+void hal_critical_exit(void);
+void hal_yield(void);
+
+#define taskENTER_CRITICAL() hal_critical_enter()
+#define taskEXIT_CRITICAL()  hal_critical_exit()
+#define taskYIELD()          hal_yield()
+
+#endif
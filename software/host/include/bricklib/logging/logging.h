@@ -0,0 +1,32 @@
+/* imu-v2-brick
+ *
+ * logging.h: Host replacement for the logging macros, only errors are printed
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_LOGGING_LOGGING_H
+#define HOST_LOGGING_LOGGING_H
+
+#include <stdio.h>
+
+#define logd(str, ...) do {} while(0)
+#define logi(str, ...) do {} while(0)
+#define logw(str, ...) do {} while(0)
+// logf is left out, it would shadow logf() of math.h on the host
+#define loge(str, ...) do { fprintf(stderr, str, ##__VA_ARGS__); } while(0)
+
+#endif
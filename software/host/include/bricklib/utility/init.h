@@ -0,0 +1,30 @@
+/* imu-v2-brick
+ *
+ * init.h: Host replacement for the brick initialization
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_UTILITY_INIT_H
+#define HOST_UTILITY_INIT_H
+
+#include <stdbool.h>
+
+#include "bricklib/com/com_common.h"
+
+bool brick_init_enumeration(const ComType com);
+
+#endif
@@ -0,0 +1,36 @@
+/* imu-v2-brick
+ *
+ * util_definitions.h: Host replacement for the bricklib utility macros
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_UTILITY_UTIL_DEFINITIONS_H
+#define HOST_UTILITY_UTIL_DEFINITIONS_H
+
+#include "bricklib/free_rtos/include/task.h"
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define ABS(a) (((a) < 0) ? -(a) : (a))
+#define BETWEEN(min, value, max) (MIN((max), MAX((min), (value))))
+
+#define SLEEP_MS(x) vTaskDelay((x)/portTICK_RATE_MS)
+
+#define DISABLE_RESET_BUTTON() do {} while(0)
+#define ENABLE_RESET_BUTTON()  do {} while(0)
+
+#endif
@@ -0,0 +1,423 @@
+/* imu-v2-brick
+ *
+ * sim.c: Runs the firmware against the BNO055 model
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "hal.h"
+#include "bno055.h"
+#include "transport.h"
+
+#include "config.h"
+#include "communication.h"
+#include "imu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <getopt.h>
+
+// Runs one scenario and checks what the firmware did: The callbacks have
+// to arrive with their periods, the BNO055 must only be configured in
+// config mode and not be accessed during a mode switch, getters have to
+// return fresh data, the flash must only be written with flash commands
+// and a calibration save has to finish. The sample buffer has to hold
+// every sample in order. Exits with 1 if a check fails.
+
+#define SIM_PERIOD_TOLERANCE 2 // callbacks, for the start and the end of the run
+
+static const uint8_t sim_period_fid[IMU_PERIOD_NUM] = {
+	FID_ACCELERATION,
+	FID_MAGNETIC_FIELD,
+	FID_ANGULAR_VELOCITY,
+	FID_TEMPERATURE,
+	FID_ORIENTATION,
+	FID_LINEAR_ACCELERATION,
+	FID_GRAVITY_VECTOR,
+	FID_QUATERNION,
+	FID_ALL_DATA,
+	FID_COMPACT_STREAM,
+	FID_CHANNEL_DATA
+};
+
+static const char *sim_period_name[IMU_PERIOD_NUM] = {
+	"acceleration", "magnetic_field", "angular_velocity", "temperature",
+	"orientation", "linear_acceleration", "gravity_vector", "quaternion",
+	"all_data", "compact_stream", "channel_data"
+};
+
+static uint32_t sim_failures = 0;
+
+#define sim_check(condition, str, ...) do { \
+	if(!(condition)) { \
+		fprintf(stderr, "check failed: " str "\n", ##__VA_ARGS__); \
+		sim_failures++; \
+	} \
+} while(0)
+
+static void sim_usage(const char *name) {
+	fprintf(stderr,
+	        "usage: %s [options]\n"
+	        "  --mode N          operation mode (default 12, NDOF)\n"
+	        "  --interrupt       use the interrupt acquisition mode\n"
+	        "  --period T=MS     callback period of type T (0-10), can be repeated\n"
+	        "  --duration MS     simulated run time after the start (default 2000)\n"
+	        "  --getters N       getter requests spread over the run (default 0)\n"
+	        "  --save            save the calibration in the middle of the run\n"
+	        "  --idle MS         enable the idle policy (suspend) with this timeout\n"
+	        "  --twi-fail N      let N TWI transfers in the middle of the run fail\n"
+	        "  --mode-switches N switch N times between IMU mode and --mode in the\n"
+	        "                    middle of the run, at odd offsets to the tick\n"
+	        "  --buffer MASK     buffer the channels of MASK, read the samples from\n"
+	        "                    the watermark callback\n"
+	        "  --dump            print all messages\n",
+	        name);
+}
+
+static void sim_request(const uint8_t fid, const void *payload, const uint8_t length) {
+	const uint8_t error = transport_request(fid, payload, length, true, NULL, NULL);
+	sim_check(error == MESSAGE_ERROR_CODE_OK, "request %d returned %d", fid, error);
+}
+
+int main(int argc, char **argv) {
+	uint8_t mode = IMU_OPERATION_MODE_NDOF;
+	bool interrupt = false;
+	uint32_t periods[IMU_PERIOD_NUM] = {0};
+	uint32_t duration = 2000;
+	uint32_t getters = 0;
+	bool save = false;
+	uint32_t twi_fail = 0;
+	uint32_t mode_switches = 0;
+	uint32_t idle = 0;
+	uint16_t buffer = 0;
+	bool dump = false;
+
+	static const struct option options[] = {
+		{"mode",      required_argument, NULL, 'm'},
+		{"interrupt", no_argument,       NULL, 'i'},
+		{"period",    required_argument, NULL, 'p'},
+		{"duration",  required_argument, NULL, 'd'},
+		{"getters",   required_argument, NULL, 'g'},
+		{"save",      no_argument,       NULL, 's'},
+		{"idle",      required_argument, NULL, 'I'},
+		{"twi-fail",  required_argument, NULL, 'f'},
+		{"mode-switches", required_argument, NULL, 'M'},
+		{"buffer",    required_argument, NULL, 'b'},
+		{"dump",      no_argument,       NULL, 'D'},
+		{"help",      no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int option;
+	while((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch(option) {
+			case 'm': mode = atoi(optarg); break;
+			case 'i': interrupt = true; break;
+			case 'd': duration = atoi(optarg); break;
+			case 'g': getters = atoi(optarg); break;
+			case 's': save = true; break;
+			case 'I': idle = atoi(optarg); break;
+			case 'f': twi_fail = atoi(optarg); break;
+			case 'M': mode_switches = atoi(optarg); break;
+			case 'b': buffer = strtol(optarg, NULL, 0); break;
+			case 'D': dump = true; break;
+			case 'h': sim_usage(argv[0]); return 0;
+			case 'p': {
+				unsigned type, period;
+				if((sscanf(optarg, "%u=%u", &type, &period) != 2) || (type >= IMU_PERIOD_NUM)) {
+					sim_usage(argv[0]);
+					return 2;
+				}
+				periods[type] = period;
+				break;
+			}
+			default: sim_usage(argv[0]); return 2;
+		}
+	}
+
+	hal_init();
+	transport_init();
+	imu_init();
+	hal_start_scheduler();
+
+	SetOperationMode som = {.mode = mode};
+	sim_request(FID_SET_OPERATION_MODE, &som.mode, sizeof(som) - sizeof(MessageHeader));
+
+	if(interrupt) {
+		SetAcquisitionMode sam = {.mode = IMU_ACQUISITION_MODE_INTERRUPT};
+		sim_request(FID_SET_ACQUISITION_MODE, &sam.mode, sizeof(sam) - sizeof(MessageHeader));
+	}
+
+	SetCallbackPeriods scp;
+	memcpy(scp.periods, periods, sizeof(scp.periods));
+	sim_request(FID_SET_CALLBACK_PERIODS, scp.periods, sizeof(scp.periods));
+
+	const uint8_t buffer_watermark = buffer != 0 ? imu_buffer_get_samples_per_message(buffer) : 0;
+	if(buffer != 0) {
+		SetBufferConfiguration sbc = {.channel_mask = buffer, .watermark = buffer_watermark};
+		sim_request(FID_SET_BUFFER_CONFIGURATION, &sbc.channel_mask, sizeof(sbc) - sizeof(MessageHeader));
+	}
+
+	// The LEDs show the orientation, they keep the BNO055 awake
+	if(idle > 0) {
+		sim_request(FID_LEDS_OFF, NULL, 0);
+
+		SetIdlePolicy sip = {.enable = true, .power_mode = IMU_POWER_MODE_SUSPEND, .timeout = idle};
+		sim_request(FID_SET_IDLE_POLICY, &sip.enable, sizeof(sip) - sizeof(MessageHeader));
+	}
+
+	// The firmware only saves a complete calibration
+	if(save) {
+		bno055_set_calibration_status(0xFF);
+	}
+
+	// Let the first mode switch settle, the counts start after it
+	hal_run_ms(100);
+	transport_clear();
+	const BNO055Statistics bno_start = *bno055_get_statistics();
+
+	GetAcquisitionStatisticsReturn before;
+	transport_request(FID_GET_ACQUISITION_STATISTICS, NULL, 0, true, &before, NULL);
+
+	const uint64_t start = hal_get_time_us();
+	const uint64_t end = start + duration*1000ULL;
+	const uint64_t middle = start + duration*500ULL;
+	const uint64_t getter_step = getters > 0 ? (end - start)/getters : 0;
+	uint64_t next_getter = start + getter_step/2;
+	uint32_t getters_done = 0;
+	uint32_t getters_failed = 0;
+	uint32_t getters_stale = 0;
+	uint32_t getters_inconsistent = 0;
+	GetAllDataReturn getter_last;
+	memset(&getter_last, 0, sizeof(GetAllDataReturn));
+	GetChannelDataReturn channel_data_last;
+	memset(&channel_data_last, 0, sizeof(GetChannelDataReturn));
+	bool middle_done = false;
+	uint32_t int_edges_switched = 0;
+	uint64_t switched = 0;
+	uint32_t save_requests = 0;
+
+	while(hal_get_time_us() < end) {
+		uint64_t next = end;
+		if((getters_done < getters) && (next_getter < next)) {
+			next = next_getter;
+		}
+		if(!middle_done && (middle < next)) {
+			next = middle;
+		}
+
+		hal_run_until(next);
+
+		if(!middle_done && (hal_get_time_us() >= middle)) {
+			middle_done = true;
+			if(save) {
+				SaveCalibrationReturn scr;
+				transport_request(FID_SAVE_CALIBRATION, NULL, 0, true, &scr, NULL);
+				sim_check(scr.calibration_done, "calibration save not started");
+				save_requests++;
+			}
+			if(twi_fail > 0) {
+				hal_twi_fail_next(twi_fail);
+			}
+
+			// The switches land at different times within the tick and
+			// relative to the 10ms data ready of the BNO055
+			for(uint32_t i = 0; i < mode_switches; i++) {
+				hal_run_until(hal_get_time_us() + 1000 + (i*1370 + 130) % 10000);
+
+				SetOperationMode som = {.mode = (i & 1) ? mode : IMU_OPERATION_MODE_IMU};
+				sim_request(FID_SET_OPERATION_MODE, &som.mode, sizeof(som) - sizeof(MessageHeader));
+			}
+			if(mode_switches & 1) {
+				SetOperationMode som = {.mode = mode};
+				sim_request(FID_SET_OPERATION_MODE, &som.mode, sizeof(som) - sizeof(MessageHeader));
+			}
+			int_edges_switched = hal_get_statistics()->int_edges;
+			switched = hal_get_time_us();
+		}
+
+		if((getters_done < getters) && (hal_get_time_us() >= next_getter)) {
+			GetAllDataReturn gadr;
+			uint8_t length = 0;
+			if(transport_request(FID_GET_ALL_DATA, NULL, 0, true, &gadr, &length) != MESSAGE_ERROR_CODE_OK ||
+			   (length < sizeof(GetAllDataReturn))) {
+				getters_failed++;
+			}
+
+			// The fusion output changes every 10ms, a getter that comes
+			// later has to return new values, also if the BNO055 was idle
+			const uint32_t values = offsetof(GetAllDataReturn, calibration_status) - sizeof(MessageHeader);
+			if((getters_done > 0) && (getter_step >= 2*BNO055_FUSION_PERIOD) && (mode >= IMU_OPERATION_MODE_IMU) &&
+			   (memcmp(((uint8_t *)&gadr) + sizeof(MessageHeader), ((uint8_t *)&getter_last) + sizeof(MessageHeader), values) == 0)) {
+				getters_stale++;
+			}
+			getter_last = gadr;
+
+			// Two replies with the same sequence number have to carry the
+			// same sample
+			GetChannelData gcd = {.channel_mask = IMU_CHANNEL_MASK_ALL};
+			GetChannelDataReturn gcdr;
+			transport_request(FID_GET_CHANNEL_DATA, &gcd.channel_mask, sizeof(gcd) - sizeof(MessageHeader), true, &gcdr, NULL);
+			if((getters_done > 0) && (gcdr.sequence == channel_data_last.sequence) &&
+			   (memcmp(gcdr.values, channel_data_last.values, sizeof(gcdr.values)) != 0)) {
+				getters_inconsistent++;
+			}
+			channel_data_last = gcdr;
+			getters_done++;
+			next_getter += getter_step;
+		}
+	}
+
+	GetAcquisitionStatisticsReturn after;
+	transport_request(FID_GET_ACQUISITION_STATISTICS, NULL, 0, true, &after, NULL);
+
+	// Configuration errors are counted from the start, including imu_init
+	const BNO055Statistics *bno = bno055_get_statistics();
+	const HALStatistics *hal = hal_get_statistics();
+
+	printf("time_us %llu\n", (unsigned long long)(hal_get_time_us() - start));
+	printf("operation_mode %d\n", bno055_get_operation_mode());
+	printf("samples_read %u\n", after.samples_read - before.samples_read);
+	printf("samples_missed %u\n", after.samples_missed - before.samples_missed);
+	printf("samples_duplicate %u\n", after.samples_duplicate - before.samples_duplicate);
+	printf("bno055_samples %u\n", bno->samples - bno_start.samples);
+	printf("bno055_reads %u\n", bno->reads - bno_start.reads);
+	printf("bno055_writes %u\n", bno->writes - bno_start.writes);
+	printf("bno055_config_violations %u\n", bno->config_violations);
+	printf("bno055_busy_accesses %u\n", bno->busy_accesses);
+	printf("twi_busy_us %llu\n", (unsigned long long)(hal->twi_busy_ns/1000));
+	printf("twi_errors %u (aborted %u)\n", hal->twi_errors, hal->twi_aborts);
+	printf("int_edges %u (dropped %u, deferred %u)\n", hal->int_edges, hal->int_edges_dropped, hal->int_edges_deferred);
+	printf("getters %u (failed %u, stale %u, inconsistent %u)\n", getters_done, getters_failed, getters_stale, getters_inconsistent);
+
+	for(uint8_t i = 0; i < IMU_PERIOD_NUM; i++) {
+		const uint32_t period = imu_get_effective_period(i);
+		const uint32_t count = transport_get_fid_count(sim_period_fid[i]);
+		if(period == 0) {
+			continue;
+		}
+
+		const bool valid = (imu_period_channel_mask(i) & imu_get_valid_channels(mode)) != 0;
+		const uint32_t expected = valid ? duration/period : 0;
+		printf("callback %s period %u count %u expected %u\n", sim_period_name[i], period, count, expected);
+
+		// A calibration save switches to config mode and back, callbacks
+		// of that time are left out
+		const uint32_t tolerance = SIM_PERIOD_TOLERANCE + (save ? (IMU_MODE_SWITCH_TIME_CONFIG + IMU_MODE_SWITCH_TIME_OPERATION)/period + 1 : 0);
+		sim_check(count + tolerance >= expected && count <= expected + SIM_PERIOD_TOLERANCE,
+		          "%s: %u callbacks, expected %u", sim_period_name[i], count, expected);
+	}
+
+	// Every sample read after the start has to arrive once and in order,
+	// the samples from before the start are in the first message
+	if(buffer != 0) {
+		const uint8_t size = imu_buffer_get_sample_size(buffer);
+		uint32_t buffered = 0;
+		uint32_t lost = 0;
+		uint32_t disordered = 0;
+		uint32_t timestamp_last = 0;
+		for(uint32_t i = 0; i < transport_get_count(); i++) {
+			const TransportMessage *message = transport_get_message(i);
+			const BufferedSamplesCallback *bsc = (const BufferedSamplesCallback *)message->data;
+			if(bsc->header.fid != FID_BUFFERED_SAMPLES) {
+				continue;
+			}
+
+			sim_check(bsc->channel_mask == buffer, "buffered samples with channel mask %x, expected %x", bsc->channel_mask, buffer);
+			sim_check(bsc->sample_count == buffer_watermark, "%u buffered samples in a callback, watermark %u", bsc->sample_count, buffer_watermark);
+			for(uint8_t j = 0; j < bsc->sample_count; j++) {
+				uint32_t timestamp;
+				memcpy(&timestamp, &bsc->data[j*size], sizeof(uint32_t));
+				if((buffered > 0) && (timestamp <= timestamp_last)) {
+					disordered++;
+				}
+				timestamp_last = timestamp;
+				buffered++;
+			}
+			lost += bsc->samples_lost;
+		}
+
+		const uint32_t read = after.samples_read - before.samples_read;
+		printf("buffered_samples %u (lost %u, disordered %u) expected %u\n", buffered, lost, disordered, read);
+		sim_check(lost == 0, "%u buffered samples lost", lost);
+		sim_check(disordered == 0, "%u buffered samples out of order", disordered);
+		sim_check(buffered + 2*buffer_watermark >= read && buffered <= read + buffer_watermark,
+		          "%u buffered samples, expected %u", buffered, read);
+	}
+
+	// Give a running calibration save the time to finish
+	if(save) {
+		hal_run_ms(500);
+	}
+
+	if(dump) {
+		transport_dump(stdout);
+	}
+
+	uint64_t last = 0;
+	for(uint32_t i = 0; i < transport_get_count(); i++) {
+		const TransportMessage *message = transport_get_message(i);
+		sim_check(message->time >= last, "message %u sent before the previous one", i);
+		last = message->time;
+	}
+
+	sim_check(bno->config_violations == 0, "%u writes to config registers outside of config mode", bno->config_violations);
+	sim_check(bno->busy_accesses == 0, "%u accesses during a mode switch", bno->busy_accesses);
+	// A latched INT line without reset gives no further edges, the
+	// firmware would fall back to polling with twice the period. A failed
+	// reset write loses edges until the fallback poll.
+	if(interrupt && middle_done && (twi_fail == 0)) {
+		const uint32_t edges = hal->int_edges - int_edges_switched;
+		const uint32_t expected = (hal_get_time_us() - switched)/imu_get_output_period();
+		printf("int_edges_after_middle %u expected %u\n", edges, expected);
+		sim_check(edges + SIM_PERIOD_TOLERANCE >= expected, "%u INT edges after the middle of the run, expected %u", edges, expected);
+	}
+	sim_check(getters_failed == 0, "%u getters failed", getters_failed);
+	sim_check(getters_inconsistent == 0, "%u getters returned other data with the same sequence number", getters_inconsistent);
+	// A getter whose read failed returns the buffered values
+	sim_check((getters_stale == 0) || (twi_fail > 0), "%u getters returned the values of the previous getter", getters_stale);
+
+	if(idle > 0) {
+		GetIdleStatusReturn gisr;
+		transport_request(FID_GET_IDLE_STATUS, NULL, 0, true, &gisr, NULL);
+		printf("idle_wake_count %u\n", gisr.wake_count);
+		printf("idle_wake_latency_us %u\n", gisr.wake_latency);
+	}
+	sim_check(hal_flash_verify(), "flash written without a flash command");
+
+	if(save) {
+		const uint32_t saved = transport_get_fid_count(FID_CALIBRATION_SAVED);
+		printf("calibration_saved %u\n", saved);
+		sim_check(saved == save_requests, "%u calibration saves finished, %u requested", saved, save_requests);
+		sim_check(bno055_get_operation_mode() == mode, "operation mode %d after the save, expected %d", bno055_get_operation_mode(), mode);
+	}
+
+	// The model never stalls, without a mode switch or a bus error in
+	// between no sample may be lost
+	if(!save && (twi_fail == 0)) {
+		sim_check(after.samples_missed == before.samples_missed,
+		          "%u samples missed", after.samples_missed - before.samples_missed);
+	}
+
+	if(sim_failures > 0) {
+		fprintf(stderr, "%u checks failed\n", sim_failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,247 @@
+/* imu-v2-brick
+ *
+ * transport.c: Recording message transport for the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "transport.h"
+
+#include "hal.h"
+
+#include "communication.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern ComInfo com_info;
+
+#define transport_fatal(str, ...) do { fprintf(stderr, "transport: " str "\n", ##__VA_ARGS__); abort(); } while(0)
+
+static const ComMessage transport_messages[] = {
+	COM_MESSAGES_USER
+};
+
+static TransportMessage *transport_messages_recorded = NULL;
+static uint32_t transport_count = 0;
+static uint32_t transport_size = 0;
+static uint32_t transport_total = 0;
+static uint32_t transport_fid_count[256];
+static bool transport_recording = true;
+static transport_listener_func_t transport_listener = NULL;
+
+// Request in progress
+static bool transport_request_active = false;
+static uint8_t transport_request_fid = 0;
+static uint8_t transport_request_sequence = 0;
+static uint8_t transport_response[TRANSPORT_MESSAGE_SIZE_MAX];
+static uint8_t transport_response_length = 0;
+static uint8_t transport_sequence = 0;
+
+void transport_init(void) {
+	transport_clear();
+	transport_recording = true;
+	transport_listener = NULL;
+	transport_sequence = 0;
+}
+
+void transport_clear(void) {
+	transport_count = 0;
+	transport_total = 0;
+	memset(transport_fid_count, 0, sizeof(transport_fid_count));
+}
+
+void transport_set_recording(const bool recording) {
+	transport_recording = recording;
+}
+
+void transport_set_listener(transport_listener_func_t listener) {
+	transport_listener = listener;
+}
+
+uint32_t transport_get_count(void) {
+	return transport_count;
+}
+
+const TransportMessage *transport_get_message(const uint32_t index) {
+	if(index >= transport_count) {
+		return NULL;
+	}
+
+	return &transport_messages_recorded[index];
+}
+
+uint32_t transport_get_fid_count(const uint8_t fid) {
+	return transport_fid_count[fid];
+}
+
+uint32_t transport_get_total_count(void) {
+	return transport_total;
+}
+
+uint16_t send_blocking_with_timeout(const void *data, const uint16_t length, ComType com) {
+	const MessageHeader *header = data;
+	if((length < sizeof(MessageHeader)) || (length > TRANSPORT_MESSAGE_SIZE_MAX)) {
+		transport_fatal("message with invalid length %d", length);
+	}
+	if(header->length != length) {
+		transport_fatal("message %d has length %d in the header but %d were sent", header->fid, header->length, length);
+	}
+
+	TransportMessage message;
+	message.time   = hal_get_time_us();
+	message.com    = com;
+	message.length = length;
+	memcpy(message.data, data, length);
+
+	transport_total++;
+	transport_fid_count[header->fid]++;
+
+	if(transport_request_active &&
+	   (header->fid == transport_request_fid) &&
+	   (header->sequence_num == transport_request_sequence)) {
+		memcpy(transport_response, data, length);
+		transport_response_length = length;
+	}
+
+	if(transport_recording) {
+		if(transport_count == transport_size) {
+			transport_size = transport_size == 0 ? 1024 : transport_size*2;
+			transport_messages_recorded = realloc(transport_messages_recorded, transport_size*sizeof(TransportMessage));
+			if(transport_messages_recorded == NULL) {
+				transport_fatal("out of memory");
+			}
+		}
+
+		transport_messages_recorded[transport_count++] = message;
+	}
+
+	if(transport_listener != NULL) {
+		transport_listener(&message);
+	}
+
+	return length;
+}
+
+void com_make_default_header(void *data, const uint32_t uid, const uint8_t length, const uint8_t fid) {
+	MessageHeader *header = data;
+
+	header->uid              = uid;
+	header->length           = length;
+	header->fid              = fid;
+	header->sequence_num     = 0; // Sequence number for callback is 0
+	header->return_expected  = 1;
+	header->authentication   = 0;
+	header->other_options    = 0;
+	header->error            = 0;
+	header->future_use       = 0;
+}
+
+void com_return_setter(const ComType com, const void *data) {
+	if(((MessageHeader*)data)->return_expected) {
+		MessageHeader ack = *((MessageHeader*)data);
+		ack.length = sizeof(MessageHeader);
+		send_blocking_with_timeout(&ack, sizeof(MessageHeader), com);
+	}
+}
+
+void com_return_error(const void *data, const uint8_t ret_length, const uint8_t error_code, const ComType com) {
+	uint8_t message[TRANSPORT_MESSAGE_SIZE_MAX] = {0};
+	MessageHeader *header = (MessageHeader*)message;
+
+	*header        = *((MessageHeader*)data);
+	header->length = ret_length;
+	header->error  = error_code;
+
+	if(header->return_expected) {
+		send_blocking_with_timeout(message, ret_length, com);
+	}
+}
+
+// Sends a request to the firmware, the handler runs at the current
+// simulated time. Returns the error code of the response or
+// TRANSPORT_NO_RESPONSE if there was none.
+uint8_t transport_request(const uint8_t fid,
+                          const void *payload,
+                          const uint8_t payload_length,
+                          const bool response_expected,
+                          void *response,
+                          uint8_t *response_length) {
+	if(sizeof(MessageHeader) + payload_length > TRANSPORT_MESSAGE_SIZE_MAX) {
+		transport_fatal("request %d with invalid length %d", fid, payload_length);
+	}
+
+	if((fid == 0) || (fid > sizeof(transport_messages)/sizeof(ComMessage))) {
+		transport_fatal("request with unknown FID %d", fid);
+	}
+
+	// Found by position, like the brick dispatcher does it
+	const ComMessage *com_message = &transport_messages[fid - 1];
+	if(com_message->fid != fid) {
+		transport_fatal("FID %d is at the wrong position in COM_MESSAGES_USER", fid);
+	}
+
+	uint8_t request[TRANSPORT_MESSAGE_SIZE_MAX] = {0};
+	MessageHeader *header = (MessageHeader*)request;
+	transport_sequence = transport_sequence % 15 + 1;
+
+	header->uid             = com_info.uid;
+	header->length          = sizeof(MessageHeader) + payload_length;
+	header->fid             = fid;
+	header->sequence_num    = transport_sequence;
+	header->return_expected = response_expected;
+	memcpy(request + sizeof(MessageHeader), payload, payload_length);
+
+	transport_request_active   = true;
+	transport_request_fid      = fid;
+	transport_request_sequence = transport_sequence;
+	transport_response_length  = 0;
+
+	com_message->reply_func(COM_USB, request);
+
+	transport_request_active = false;
+
+	if(transport_response_length == 0) {
+		return TRANSPORT_NO_RESPONSE;
+	}
+
+	if(response != NULL) {
+		memcpy(response, transport_response, transport_response_length);
+	}
+	if(response_length != NULL) {
+		*response_length = transport_response_length;
+	}
+
+	return ((MessageHeader*)transport_response)->error;
+}
+
+void transport_dump(FILE *file) {
+	for(uint32_t i = 0; i < transport_count; i++) {
+		const TransportMessage *message = &transport_messages_recorded[i];
+		const MessageHeader *header = (const MessageHeader*)message->data;
+
+		fprintf(file, "%llu fid=%d seq=%d err=%d len=%d:",
+		        (unsigned long long)message->time,
+		        header->fid,
+		        header->sequence_num,
+		        header->error,
+		        message->length);
+		for(uint8_t j = sizeof(MessageHeader); j < message->length; j++) {
+			fprintf(file, " %02X", message->data[j]);
+		}
+		fprintf(file, "\n");
+	}
+}
@@ -0,0 +1,65 @@
+/* imu-v2-brick
+ *
+ * transport.h: Recording message transport for the host build
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bricklib/com/com_common.h"
+
+// Every message the firmware sends is recorded with the simulated time.
+// Requests are dispatched to the handlers of COM_MESSAGES_USER like the
+// brick does it, the response is found by FID and sequence number.
+
+#define TRANSPORT_MESSAGE_SIZE_MAX 80
+#define TRANSPORT_NO_RESPONSE      0xFF
+
+typedef struct {
+	uint64_t time; // in µs
+	ComType com;
+	uint8_t length;
+	uint8_t data[TRANSPORT_MESSAGE_SIZE_MAX];
+} TransportMessage;
+
+typedef void (*transport_listener_func_t)(const TransportMessage *message);
+
+void transport_init(void);
+void transport_clear(void);
+void transport_set_recording(const bool recording);
+void transport_set_listener(transport_listener_func_t listener);
+
+uint32_t transport_get_count(void);
+const TransportMessage *transport_get_message(const uint32_t index);
+uint32_t transport_get_fid_count(const uint8_t fid);
+uint32_t transport_get_total_count(void);
+
+uint8_t transport_request(const uint8_t fid,
+                          const void *payload,
+                          const uint8_t payload_length,
+                          const bool response_expected,
+                          void *response,
+                          uint8_t *response_length);
+
+void transport_dump(FILE *file);
+
+#endif
@@ -37,12 +37,62 @@
 
 extern uint32_t imu_period[IMU_PERIOD_NUM];
 extern uint32_t imu_period_counter[IMU_PERIOD_NUM];
+extern uint32_t imu_period_min;
 
-extern SensorData sensor_data;
 extern bool imu_use_leds;
 
+extern uint8_t imu_acquisition_mode;
+extern uint16_t imu_acquisition_period;
+extern uint8_t imu_operation_mode;
+extern IMUSensorConfiguration imu_sensor_configuration;
+extern uint16_t imu_compact_channels;
+extern uint8_t imu_compact_keyframe_interval;
+extern uint16_t imu_channel_data_channels;
+extern bool imu_callback_coalescing;
+extern bool imu_sample_info;
+extern IMUThreshold imu_threshold[IMU_THRESHOLD_NUM];
+extern IMUMotionConfiguration imu_motion_configuration;
+extern bool imu_idle_enable;
+extern uint8_t imu_idle_power_mode;
+extern uint32_t imu_idle_timeout;
+extern bool imu_idle;
+extern uint32_t imu_wake_latency;
+extern uint32_t imu_wake_count;
+extern bool imu_calibration_auto_save;
+extern bool imu_calibration_status_callback_enable;
+
+extern uint32_t imu_samples_read;
+extern uint32_t imu_samples_missed;
+extern uint32_t imu_samples_duplicate;
+
+extern uint32_t imu_channel_sample_period[IMU_CHANNEL_NUM];
+
+extern uint16_t imu_buffer_channels;
+extern uint8_t imu_buffer_watermark;
+
+// Position of every message in COM_MESSAGES_USER
+#define COM_MESSAGE_USER_INDEX(fid, handler) COM_MESSAGE_USER_INDEX_##fid,
+enum {
+	COM_MESSAGES_USER_LIST(COM_MESSAGE_USER_INDEX)
+	COM_MESSAGES_USER_NUM
+};
+
+// Compile time checks that the list is sorted and dense: The message at
+// position i has FID i+1 and the list ends with FID_LAST_USER. The brick
+// dispatcher finds the handler of a FID by its position in
+// COM_MESSAGES_USER.
+#define COM_MESSAGE_USER_CHECK(fid, handler) \
+	typedef char com_message_user_check_##fid[((fid) == COM_MESSAGE_USER_INDEX_##fid + 1) ? 1 : -1];
+COM_MESSAGES_USER_LIST(COM_MESSAGE_USER_CHECK)
+typedef char com_messages_user_num_check[(COM_MESSAGES_USER_NUM == FID_LAST_USER) ? 1 : -1];
+typedef char channel_data_size_check[(sizeof(((GetChannelDataReturn*)0)->values) == IMU_CHANNEL_VALUES_MAX*sizeof(int16_t)) ? 1 : -1];
+typedef char callback_periods_size_check[(sizeof(((SetCallbackPeriods*)0)->periods) == IMU_PERIOD_NUM*sizeof(uint32_t)) ? 1 : -1];
+
 void get_acceleration(const ComType com, const GetAcceleration *data) {
 	GetAccelerationReturn gar;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_ACC, &sensor_data, &info);
 
 	gar.header        = data->header;
 	gar.header.length = sizeof(GetAccelerationReturn);
@@ -50,11 +100,14 @@ void get_acceleration(const ComType com, const GetAcceleration *data) {
 	gar.y             = sensor_data.acc_y;
 	gar.z             = sensor_data.acc_z;
 
-	send_blocking_with_timeout(&gar, sizeof(GetAccelerationReturn), com);
+	imu_send_sample(&gar, sizeof(GetAccelerationReturn), com, &info);
 }
 
 void get_magnetic_field(const ComType com, const GetMagneticField *data) {
 	GetMagneticFieldReturn gmfr;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_MAG, &sensor_data, &info);
 
 	gmfr.header        = data->header;
 	gmfr.header.length = sizeof(GetMagneticFieldReturn);
@@ -62,11 +115,14 @@ void get_magnetic_field(const ComType com, const GetMagneticField *data) {
 	gmfr.y             = sensor_data.mag_y;
 	gmfr.z             = sensor_data.mag_z;
 
-	send_blocking_with_timeout(&gmfr, sizeof(GetMagneticFieldReturn), com);
+	imu_send_sample(&gmfr, sizeof(GetMagneticFieldReturn), com, &info);
 }
 
 void get_angular_velocity(const ComType com, const GetAngularVelocity *data) {
 	GetAngularVelocityReturn gavr;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_ANG, &sensor_data, &info);
 
 	gavr.header        = data->header;
 	gavr.header.length = sizeof(GetAngularVelocityReturn);
@@ -74,21 +130,27 @@ void get_angular_velocity(const ComType com, const GetAngularVelocity *data) {
 	gavr.y             = sensor_data.gyr_y;
 	gavr.z             = sensor_data.gyr_z;
 
-	send_blocking_with_timeout(&gavr, sizeof(GetAngularVelocityReturn), com);
+	imu_send_sample(&gavr, sizeof(GetAngularVelocityReturn), com, &info);
 }
 
 void get_temperature(const ComType com, const GetTemperature *data) {
 	GetTemperatureReturn gtr;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_TMP, &sensor_data, &info);
 
 	gtr.header        = data->header;
 	gtr.header.length = sizeof(GetTemperatureReturn);
 	gtr.temperature   = sensor_data.temperature;
 
-	send_blocking_with_timeout(&gtr, sizeof(GetTemperatureReturn), com);
+	imu_send_sample(&gtr, sizeof(GetTemperatureReturn), com, &info);
 }
 
 void get_orientation(const ComType com, const GetOrientation *data) {
 	GetOrientationReturn gor;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_ORI, &sensor_data, &info);
 
 	gor.header        = data->header;
 	gor.header.length = sizeof(GetOrientationReturn);
@@ -96,11 +158,14 @@ void get_orientation(const ComType com, const GetOrientation *data) {
 	gor.pitch         = sensor_data.eul_pitch;
 	gor.heading       = sensor_data.eul_heading;
 
-	send_blocking_with_timeout(&gor, sizeof(GetOrientationReturn), com);
+	imu_send_sample(&gor, sizeof(GetOrientationReturn), com, &info);
 }
 
 void get_linear_acceleration(const ComType com, const GetLinearAcceleration *data) {
 	GetLinearAccelerationReturn glar;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_LIA, &sensor_data, &info);
 
 	glar.header        = data->header;
 	glar.header.length = sizeof(GetLinearAccelerationReturn);
@@ -108,11 +173,14 @@ void get_linear_acceleration(const ComType com, const GetLinearAcceleration *dat
 	glar.y             = sensor_data.lia_y;
 	glar.z             = sensor_data.lia_z;
 
-	send_blocking_with_timeout(&glar, sizeof(GetLinearAccelerationReturn), com);
+	imu_send_sample(&glar, sizeof(GetLinearAccelerationReturn), com, &info);
 }
 
 void get_gravity_vector(const ComType com, const GetGravityVector *data) {
 	GetGravityVectorReturn ggvr;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_GRV, &sensor_data, &info);
 
 	ggvr.header        = data->header;
 	ggvr.header.length = sizeof(GetGravityVectorReturn);
@@ -120,11 +188,14 @@ void get_gravity_vector(const ComType com, const GetGravityVector *data) {
 	ggvr.y             = sensor_data.grv_y;
 	ggvr.z             = sensor_data.grv_z;
 
-	send_blocking_with_timeout(&ggvr, sizeof(GetGravityVectorReturn), com);
+	imu_send_sample(&ggvr, sizeof(GetGravityVectorReturn), com, &info);
 }
 
 void get_quaternion(const ComType com, const GetQuaternion *data) {
 	GetQuaternionReturn gqr;
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_fresh_sensor_data(1 << IMU_CHANNEL_QUA, &sensor_data, &info);
 
 	gqr.header        = data->header;
 	gqr.header.length = sizeof(GetQuaternionReturn);
@@ -133,17 +204,18 @@ void get_quaternion(const ComType com, const GetQuaternion *data) {
 	gqr.z             = sensor_data.qua_z;
 	gqr.w             = sensor_data.qua_w;
 
-	send_blocking_with_timeout(&gqr, sizeof(GetQuaternionReturn), com);
+	imu_send_sample(&gqr, sizeof(GetQuaternionReturn), com, &info);
 }
 
 void get_all_data(const ComType com, const GetAllData *data) {
 	GetAllDataReturn gadr;
+	SampleInfo info;
 
 	gadr.header        = data->header;
 	gadr.header.length = sizeof(GetAllDataReturn);
-	memcpy(&gadr.acceleration, &sensor_data, sizeof(SensorData));
+	imu_get_fresh_sensor_data(IMU_CHANNEL_MASK_ALL, (SensorData*)gadr.acceleration, &info);
 
-	send_blocking_with_timeout(&gadr, sizeof(GetAllDataReturn), com);
+	imu_send_sample(&gadr, sizeof(GetAllDataReturn), com, &info);
 }
 
 void leds_on(const ComType com, const LedsOn *data) {
@@ -173,7 +245,9 @@ void save_calibration(const ComType com, const SaveCalibration *data) {
 
 	scr.header               = data->header;
 	scr.header.length        = sizeof(SaveCalibrationReturn);
-	if(read_calibration_from_bno055_and_save_to_flash()) {
+	// The calibration is saved in the background, CALIBRATION_SAVED
+	// is sent when it is done
+	if(imu_calibration_save_start()) {
 		scr.calibration_done = true;
 	} else {
 		scr.calibration_done = false;
@@ -353,3 +427,510 @@ void get_all_data_period(const ComType com, const GetAllDataPeriod *data) {
 	logimui("get_all_data_period: %d\n\r", imu_period[IMU_PERIOD_TYPE_ALL]);
 }
 
+void set_acquisition_mode(const ComType com, const SetAcquisitionMode *data) {
+	if(data->mode > IMU_ACQUISITION_MODE_INTERRUPT) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_set_acquisition_mode(data->mode);
+	logimui("set_acquisition_mode: %d\n\r", imu_acquisition_mode);
+
+	com_return_setter(com, data);
+}
+
+void get_acquisition_mode(const ComType com, const GetAcquisitionMode *data) {
+	GetAcquisitionModeReturn gamr;
+
+	gamr.header        = data->header;
+	gamr.header.length = sizeof(GetAcquisitionModeReturn);
+	gamr.mode          = imu_acquisition_mode;
+
+	send_blocking_with_timeout(&gamr, sizeof(GetAcquisitionModeReturn), com);
+}
+
+void get_acquisition_statistics(const ComType com, const GetAcquisitionStatistics *data) {
+	GetAcquisitionStatisticsReturn gasr;
+
+	gasr.header            = data->header;
+	gasr.header.length     = sizeof(GetAcquisitionStatisticsReturn);
+	gasr.samples_read      = imu_samples_read;
+	gasr.samples_missed    = imu_samples_missed;
+	gasr.samples_duplicate = imu_samples_duplicate;
+
+	send_blocking_with_timeout(&gasr, sizeof(GetAcquisitionStatisticsReturn), com);
+}
+
+void set_buffer_configuration(const ComType com, const SetBufferConfiguration *data) {
+	// A channel mask of 0 disables the buffer, the watermark callback sends
+	// at most one message worth of samples
+	if((data->channel_mask & ~IMU_CHANNEL_MASK_ALL) ||
+	   ((data->channel_mask != 0) && (data->watermark > imu_buffer_get_samples_per_message(data->channel_mask)))) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_buffer_configure(data->channel_mask, data->watermark);
+	logimui("set_buffer_configuration: %d %d\n\r", imu_buffer_channels, imu_buffer_watermark);
+
+	com_return_setter(com, data);
+}
+
+void get_buffer_configuration(const ComType com, const GetBufferConfiguration *data) {
+	GetBufferConfigurationReturn gbcr;
+
+	gbcr.header        = data->header;
+	gbcr.header.length = sizeof(GetBufferConfigurationReturn);
+	gbcr.channel_mask  = imu_buffer_channels;
+	gbcr.watermark     = imu_buffer_watermark;
+
+	send_blocking_with_timeout(&gbcr, sizeof(GetBufferConfigurationReturn), com);
+}
+
+void get_buffered_samples(const ComType com, const GetBufferedSamples *data) {
+	GetBufferedSamplesReturn gbsr;
+	uint16_t samples_lost;
+
+	gbsr.header        = data->header;
+	gbsr.header.length = sizeof(GetBufferedSamplesReturn);
+	gbsr.channel_mask  = imu_buffer_channels;
+	memset(gbsr.data, 0, sizeof(gbsr.data));
+	gbsr.sample_count  = imu_buffer_pop(gbsr.data,
+	                                    MIN(data->count, imu_buffer_get_samples_per_message(imu_buffer_channels)),
+	                                    &samples_lost);
+	gbsr.samples_lost  = samples_lost;
+
+	send_blocking_with_timeout(&gbsr, sizeof(GetBufferedSamplesReturn), com);
+}
+
+void set_channel_sample_period(const ComType com, const SetChannelSamplePeriod *data) {
+	if(data->channel >= IMU_CHANNEL_NUM) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_channel_sample_period[data->channel] = data->period;
+	logimui("set_channel_sample_period: %d %d\n\r", data->channel, data->period);
+
+	com_return_setter(com, data);
+}
+
+void get_channel_sample_period(const ComType com, const GetChannelSamplePeriod *data) {
+	if(data->channel >= IMU_CHANNEL_NUM) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	GetChannelSamplePeriodReturn gcspr;
+
+	gcspr.header        = data->header;
+	gcspr.header.length = sizeof(GetChannelSamplePeriodReturn);
+	gcspr.period        = imu_channel_sample_period[data->channel];
+
+	send_blocking_with_timeout(&gcspr, sizeof(GetChannelSamplePeriodReturn), com);
+}
+
+// The acquisition period must not be shorter than the output data period of
+// the BNO055 in the current operation mode and sensor configuration
+void set_acquisition_period(const ComType com, const SetAcquisitionPeriod *data) {
+	if((data->period*1000 < imu_get_output_period()) ||
+	   (data->period > IMU_ACQUISITION_PERIOD_MAX) ||
+	   ((data->callback_period_min != 0) &&
+	    ((data->callback_period_min < data->period) ||
+	     (data->callback_period_min > IMU_CALLBACK_PERIOD_MIN_MAX)))) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_acquisition_period = data->period;
+	imu_period_min         = data->callback_period_min;
+	logimui("set_acquisition_period: %d %d\n\r", imu_acquisition_period, imu_period_min);
+
+	com_return_setter(com, data);
+}
+
+void get_acquisition_period(const ComType com, const GetAcquisitionPeriod *data) {
+	GetAcquisitionPeriodReturn gapr;
+
+	gapr.header              = data->header;
+	gapr.header.length       = sizeof(GetAcquisitionPeriodReturn);
+	gapr.period              = imu_acquisition_period;
+	gapr.callback_period_min = imu_period_min;
+
+	send_blocking_with_timeout(&gapr, sizeof(GetAcquisitionPeriodReturn), com);
+}
+
+void set_operation_mode(const ComType com, const SetOperationMode *data) {
+	if((data->mode == IMU_OPERATION_MODE_CONFIG) ||
+	   (data->mode > IMU_OPERATION_MODE_NDOF)) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_set_operation_mode(data->mode);
+	logimui("set_operation_mode: %d\n\r", imu_operation_mode);
+
+	com_return_setter(com, data);
+}
+
+void get_operation_mode(const ComType com, const GetOperationMode *data) {
+	GetOperationModeReturn gomr;
+
+	gomr.header        = data->header;
+	gomr.header.length = sizeof(GetOperationModeReturn);
+	gomr.mode          = imu_operation_mode;
+
+	send_blocking_with_timeout(&gomr, sizeof(GetOperationModeReturn), com);
+}
+
+void set_sensor_configuration(const ComType com, const SetSensorConfiguration *data) {
+	if((data->accelerometer_range > RANGE_ACCELEROMETER_16G) ||
+	   (data->accelerometer_bandwidth > BANDWIDTH_ACCELEROMETER_1000HZ) ||
+	   (data->gyroscope_range > RANGE_GYROSCOPE_125DPS) ||
+	   (data->gyroscope_bandwidth > BANDWIDTH_GYROSCOPE_32HZ) ||
+	   (data->magnetometer_rate > DATA_RATE_MAGNETOMETER_30HZ)) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	IMUSensorConfiguration config;
+	config.accelerometer_range     = data->accelerometer_range;
+	config.accelerometer_bandwidth = data->accelerometer_bandwidth;
+	config.gyroscope_range         = data->gyroscope_range;
+	config.gyroscope_bandwidth     = data->gyroscope_bandwidth;
+	config.magnetometer_rate       = data->magnetometer_rate;
+
+	imu_set_sensor_configuration(&config);
+	logimui("set_sensor_configuration: %d %d %d %d %d\n\r",
+	        data->accelerometer_range,
+	        data->accelerometer_bandwidth,
+	        data->gyroscope_range,
+	        data->gyroscope_bandwidth,
+	        data->magnetometer_rate);
+
+	com_return_setter(com, data);
+}
+
+void get_sensor_configuration(const ComType com, const GetSensorConfiguration *data) {
+	GetSensorConfigurationReturn gscr;
+
+	gscr.header                  = data->header;
+	gscr.header.length           = sizeof(GetSensorConfigurationReturn);
+	gscr.accelerometer_range     = imu_sensor_configuration.accelerometer_range;
+	gscr.accelerometer_bandwidth = imu_sensor_configuration.accelerometer_bandwidth;
+	gscr.gyroscope_range         = imu_sensor_configuration.gyroscope_range;
+	gscr.gyroscope_bandwidth     = imu_sensor_configuration.gyroscope_bandwidth;
+	gscr.magnetometer_rate       = imu_sensor_configuration.magnetometer_rate;
+
+	send_blocking_with_timeout(&gscr, sizeof(GetSensorConfigurationReturn), com);
+}
+
+void set_compact_stream_configuration(const ComType com, const SetCompactStreamConfiguration *data) {
+	if((data->channel_mask & ~IMU_CHANNEL_MASK_ALL) || (data->keyframe_interval == 0)) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_compact_configure(data->channel_mask, data->keyframe_interval);
+	imu_period[IMU_PERIOD_TYPE_CMP] = data->period;
+	imu_period_counter[IMU_PERIOD_TYPE_CMP] = 0;
+	logimui("set_compact_stream_configuration: %d %d %d\n\r",
+	        imu_compact_channels,
+	        imu_period[IMU_PERIOD_TYPE_CMP],
+	        imu_compact_keyframe_interval);
+
+	com_return_setter(com, data);
+}
+
+void get_compact_stream_configuration(const ComType com, const GetCompactStreamConfiguration *data) {
+	GetCompactStreamConfigurationReturn gcscr;
+
+	gcscr.header            = data->header;
+	gcscr.header.length     = sizeof(GetCompactStreamConfigurationReturn);
+	gcscr.channel_mask      = imu_compact_channels;
+	gcscr.period            = imu_period[IMU_PERIOD_TYPE_CMP];
+	gcscr.keyframe_interval = imu_compact_keyframe_interval;
+
+	send_blocking_with_timeout(&gcscr, sizeof(GetCompactStreamConfigurationReturn), com);
+}
+
+void set_channel_data_configuration(const ComType com, const SetChannelDataConfiguration *data) {
+	if((data->channel_mask & ~IMU_CHANNEL_MASK_ALL) || (data->channel_mask == 0)) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_channel_data_channels = data->channel_mask;
+	imu_period[IMU_PERIOD_TYPE_MSK] = data->period;
+	imu_period_counter[IMU_PERIOD_TYPE_MSK] = 0;
+	logimui("set_channel_data_configuration: %d %d\n\r",
+	        imu_channel_data_channels,
+	        imu_period[IMU_PERIOD_TYPE_MSK]);
+
+	com_return_setter(com, data);
+}
+
+void get_channel_data_configuration(const ComType com, const GetChannelDataConfiguration *data) {
+	GetChannelDataConfigurationReturn gcdcr;
+
+	gcdcr.header        = data->header;
+	gcdcr.header.length = sizeof(GetChannelDataConfigurationReturn);
+	gcdcr.channel_mask  = imu_channel_data_channels;
+	gcdcr.period        = imu_period[IMU_PERIOD_TYPE_MSK];
+
+	send_blocking_with_timeout(&gcdcr, sizeof(GetChannelDataConfigurationReturn), com);
+}
+
+void set_callback_coalescing(const ComType com, const SetCallbackCoalescing *data) {
+	imu_callback_coalescing = data->enable;
+	logimui("set_callback_coalescing: %d\n\r", imu_callback_coalescing);
+
+	com_return_setter(com, data);
+}
+
+void get_callback_coalescing(const ComType com, const GetCallbackCoalescing *data) {
+	GetCallbackCoalescingReturn gccr;
+
+	gccr.header        = data->header;
+	gccr.header.length = sizeof(GetCallbackCoalescingReturn);
+	gccr.enable        = imu_callback_coalescing;
+
+	send_blocking_with_timeout(&gccr, sizeof(GetCallbackCoalescingReturn), com);
+}
+
+void set_sample_info(const ComType com, const SetSampleInfo *data) {
+	imu_sample_info = data->enable;
+	logimui("set_sample_info: %d\n\r", imu_sample_info);
+
+	com_return_setter(com, data);
+}
+
+void get_sample_info(const ComType com, const GetSampleInfo *data) {
+	GetSampleInfoReturn gsir;
+
+	gsir.header        = data->header;
+	gsir.header.length = sizeof(GetSampleInfoReturn);
+	gsir.enable        = imu_sample_info;
+
+	send_blocking_with_timeout(&gsir, sizeof(GetSampleInfoReturn), com);
+}
+
+void set_callback_threshold(const ComType com, const SetCallbackThreshold *data) {
+	if((data->callback >= IMU_THRESHOLD_NUM) ||
+	   (data->mode > IMU_THRESHOLD_MODE_QUATERNION) ||
+	   ((data->mode == IMU_THRESHOLD_MODE_QUATERNION) &&
+	    ((data->callback != IMU_PERIOD_TYPE_QUA) || (data->threshold > IMU_THRESHOLD_QUATERNION_MAX)))) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_threshold_configure(data->callback, data->mode, data->threshold, data->keepalive);
+	logimui("set_callback_threshold: %d %d %d %d\n\r",
+	        data->callback,
+	        data->mode,
+	        data->threshold,
+	        data->keepalive);
+
+	com_return_setter(com, data);
+}
+
+void get_callback_threshold(const ComType com, const GetCallbackThreshold *data) {
+	if(data->callback >= IMU_THRESHOLD_NUM) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	GetCallbackThresholdReturn gctr;
+
+	gctr.header        = data->header;
+	gctr.header.length = sizeof(GetCallbackThresholdReturn);
+	gctr.mode          = imu_threshold[data->callback].mode;
+	gctr.threshold     = imu_threshold[data->callback].threshold;
+	gctr.keepalive     = imu_threshold[data->callback].keepalive;
+
+	send_blocking_with_timeout(&gctr, sizeof(GetCallbackThresholdReturn), com);
+}
+
+void set_motion_configuration(const ComType com, const SetMotionConfiguration *data) {
+	if((data->interrupts & ~INT_MOTION_MASK) ||
+	   (data->any_motion_duration > 3) ||
+	   (data->no_motion_duration > 63) ||
+	   (data->gyroscope_any_motion_threshold > 127)) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	IMUMotionConfiguration config;
+	memcpy(&config, &data->interrupts, sizeof(IMUMotionConfiguration));
+
+	imu_set_motion_configuration(&config);
+	logimui("set_motion_configuration: %d\n\r", data->interrupts);
+
+	com_return_setter(com, data);
+}
+
+void get_motion_configuration(const ComType com, const GetMotionConfiguration *data) {
+	GetMotionConfigurationReturn gmcr;
+
+	gmcr.header        = data->header;
+	gmcr.header.length = sizeof(GetMotionConfigurationReturn);
+	memcpy(&gmcr.interrupts, &imu_motion_configuration, sizeof(IMUMotionConfiguration));
+
+	send_blocking_with_timeout(&gmcr, sizeof(GetMotionConfigurationReturn), com);
+}
+
+void set_idle_policy(const ComType com, const SetIdlePolicy *data) {
+	if((data->power_mode != IMU_POWER_MODE_LOW_POWER) &&
+	   (data->power_mode != IMU_POWER_MODE_SUSPEND)) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	imu_idle_enable     = data->enable;
+	imu_idle_power_mode = data->power_mode;
+	imu_idle_timeout    = data->timeout;
+	imu_wake();
+	logimui("set_idle_policy: %d %d %d\n\r", imu_idle_enable, imu_idle_power_mode, imu_idle_timeout);
+
+	com_return_setter(com, data);
+}
+
+void get_idle_policy(const ComType com, const GetIdlePolicy *data) {
+	GetIdlePolicyReturn gipr;
+
+	gipr.header        = data->header;
+	gipr.header.length = sizeof(GetIdlePolicyReturn);
+	gipr.enable        = imu_idle_enable;
+	gipr.power_mode    = imu_idle_power_mode;
+	gipr.timeout       = imu_idle_timeout;
+
+	send_blocking_with_timeout(&gipr, sizeof(GetIdlePolicyReturn), com);
+}
+
+void get_idle_status(const ComType com, const GetIdleStatus *data) {
+	GetIdleStatusReturn gisr;
+
+	gisr.header        = data->header;
+	gisr.header.length = sizeof(GetIdleStatusReturn);
+	gisr.idle          = imu_idle;
+	gisr.wake_count    = imu_wake_count;
+	gisr.wake_latency  = imu_wake_latency;
+
+	send_blocking_with_timeout(&gisr, sizeof(GetIdleStatusReturn), com);
+}
+
+void get_performance_statistics(const ComType com, const GetPerformanceStatistics *data) {
+	if(data->stage >= IMU_PERF_STAGE_NUM) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	GetPerformanceStatisticsReturn gpsr;
+	IMUPerfStatistics perf;
+
+	imu_perf_get(data->stage, &perf);
+
+	gpsr.header        = data->header;
+	gpsr.header.length = sizeof(GetPerformanceStatisticsReturn);
+	gpsr.count         = perf.count;
+	gpsr.min           = perf.count == 0 ? 0 : perf.min;
+	gpsr.max           = perf.max;
+	gpsr.mean          = perf.count == 0 ? 0 : perf.sum/perf.count;
+	gpsr.overruns      = perf.overruns;
+
+	send_blocking_with_timeout(&gpsr, sizeof(GetPerformanceStatisticsReturn), com);
+}
+
+void reset_performance_statistics(const ComType com, const ResetPerformanceStatistics *data) {
+	imu_perf_reset();
+
+	com_return_setter(com, data);
+}
+
+void get_latency_histogram(const ComType com, const GetLatencyHistogram *data) {
+	if(data->callback >= IMU_PERIOD_NUM) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	GetLatencyHistogramReturn glhr;
+	uint32_t buckets[IMU_LATENCY_BUCKET_NUM];
+	imu_latency_get(data->callback, buckets);
+
+	glhr.header        = data->header;
+	glhr.header.length = sizeof(GetLatencyHistogramReturn);
+	memcpy(glhr.buckets, buckets, sizeof(buckets));
+
+	send_blocking_with_timeout(&glhr, sizeof(GetLatencyHistogramReturn), com);
+}
+
+void reset_latency_histogram(const ComType com, const ResetLatencyHistogram *data) {
+	imu_latency_reset();
+
+	com_return_setter(com, data);
+}
+
+void set_callback_periods(const ComType com, const SetCallbackPeriods *data) {
+	uint32_t periods[IMU_PERIOD_NUM];
+	memcpy(periods, data->periods, sizeof(periods));
+
+	imu_set_periods(periods);
+	logimui("set_callback_periods\n\r");
+
+	com_return_setter(com, data);
+}
+
+void get_callback_periods(const ComType com, const GetCallbackPeriods *data) {
+	GetCallbackPeriodsReturn gcpr;
+
+	gcpr.header        = data->header;
+	gcpr.header.length = sizeof(GetCallbackPeriodsReturn);
+	memcpy(gcpr.periods, imu_period, sizeof(gcpr.periods));
+
+	send_blocking_with_timeout(&gcpr, sizeof(GetCallbackPeriodsReturn), com);
+}
+
+// Returns the values of the requested channels from one sample, packed
+// in channel order. The length of the response depends on the mask.
+void get_channel_data(const ComType com, const GetChannelData *data) {
+	if((data->channel_mask & ~IMU_CHANNEL_MASK_ALL) || (data->channel_mask == 0)) {
+		com_return_error(data, sizeof(MessageHeader), MESSAGE_ERROR_CODE_INVALID_PARAMETER, com);
+		return;
+	}
+
+	GetChannelDataReturn gcdr;
+	SensorData sensor_data;
+	SampleInfo info;
+	int16_t values[IMU_CHANNEL_VALUES_MAX];
+	imu_get_fresh_sensor_data(data->channel_mask, &sensor_data, &info);
+
+	const uint8_t num = imu_pack_channels(&sensor_data, data->channel_mask, values);
+	const uint8_t size = sizeof(GetChannelDataReturn) - sizeof(gcdr.values) + num*sizeof(int16_t);
+
+	gcdr.header        = data->header;
+	gcdr.header.length = size;
+	gcdr.sequence      = info.sequence;
+	gcdr.channel_mask  = data->channel_mask;
+	memcpy(gcdr.values, values, num*sizeof(int16_t));
+
+	send_blocking_with_timeout(&gcdr, size, com);
+}
+
+void set_calibration_configuration(const ComType com, const SetCalibrationConfiguration *data) {
+	imu_calibration_auto_save              = data->auto_save;
+	imu_calibration_status_callback_enable = data->status_changed_callback;
+	logimui("set_calibration_configuration: %d %d\n\r", imu_calibration_auto_save, imu_calibration_status_callback_enable);
+
+	com_return_setter(com, data);
+}
+
+void get_calibration_configuration(const ComType com, const GetCalibrationConfiguration *data) {
+	GetCalibrationConfigurationReturn gccr;
+
+	gccr.header                  = data->header;
+	gccr.header.length           = sizeof(GetCalibrationConfigurationReturn);
+	gccr.auto_save               = imu_calibration_auto_save;
+	gccr.status_changed_callback = imu_calibration_status_callback_enable;
+
+	send_blocking_with_timeout(&gccr, sizeof(GetCalibrationConfigurationReturn), com);
+}
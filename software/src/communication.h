@@ -68,49 +68,148 @@
 #define FID_GRAVITY_VECTOR 38
 #define FID_QUATERNION 39
 #define FID_ALL_DATA 40
-
-
-#define COM_MESSAGES_USER \
-	{FID_GET_ACCELERATION, (message_handler_func_t)get_acceleration}, \
-	{FID_GET_MAGNETIC_FIELD, (message_handler_func_t)get_magnetic_field}, \
-	{FID_GET_ANGULAR_VELOCITY, (message_handler_func_t)get_angular_velocity}, \
-	{FID_GET_TEMPERATURE, (message_handler_func_t)get_temperature}, \
-	{FID_GET_ORIENTATION, (message_handler_func_t)get_orientation}, \
-	{FID_GET_QUATERNION, (message_handler_func_t)get_quaternion}, \
-	{FID_GET_LINEAR_ACCELERATION, (message_handler_func_t)get_linear_acceleration}, \
-	{FID_GET_GRAVITY_VECTOR, (message_handler_func_t)get_gravity_vector}, \
-	{FID_GET_ALL_DATA, (message_handler_func_t)get_all_data}, \
-	{FID_LEDS_ON, (message_handler_func_t)leds_on}, \
-	{FID_LEDS_OFF, (message_handler_func_t)leds_off}, \
-	{FID_ARE_LEDS_ON, (message_handler_func_t)are_leds_on}, \
-	{FID_SAVE_CALIBRATION, (message_handler_func_t)save_calibration}, \
-	{FID_SET_ACCELERATION_PERIOD, (message_handler_func_t)set_acceleration_period}, \
-	{FID_GET_ACCELERATION_PERIOD, (message_handler_func_t)get_acceleration_period}, \
-	{FID_SET_MAGNETIC_FIELD_PERIOD, (message_handler_func_t)set_magnetic_field_period}, \
-	{FID_GET_MAGNETIC_FIELD_PERIOD, (message_handler_func_t)get_magnetic_field_period}, \
-	{FID_SET_ANGULAR_VELOCITY_PERIOD, (message_handler_func_t)set_angular_velocity_period}, \
-	{FID_GET_ANGULAR_VELOCITY_PERIOD, (message_handler_func_t)get_angular_velocity_period}, \
-	{FID_SET_TEMPERATURE_PERIOD, (message_handler_func_t)set_temperature_period}, \
-	{FID_GET_TEMPERATURE_PERIOD, (message_handler_func_t)get_temperature_period}, \
-	{FID_SET_ORIENTATION_PERIOD, (message_handler_func_t)set_orientation_period}, \
-	{FID_GET_ORIENTATION_PERIOD, (message_handler_func_t)get_orientation_period}, \
-	{FID_SET_LINEAR_ACCELERATION_PERIOD, (message_handler_func_t)set_linear_acceleration_period}, \
-	{FID_GET_LINEAR_ACCELERATION_PERIOD, (message_handler_func_t)get_linear_acceleration_period}, \
-	{FID_SET_GRAVITY_VECTOR_PERIOD, (message_handler_func_t)set_gravity_vector_period}, \
-	{FID_GET_GRAVITY_VECTOR_PERIOD, (message_handler_func_t)get_gravity_vector_period}, \
-	{FID_SET_QUATERNION_PERIOD, (message_handler_func_t)set_quaternion_period}, \
-	{FID_GET_QUATERNION_PERIOD, (message_handler_func_t)get_quaternion_period}, \
-	{FID_SET_ALL_DATA_PERIOD, (message_handler_func_t)set_all_data_period}, \
-	{FID_GET_ALL_DATA_PERIOD, (message_handler_func_t)get_all_data_period}, \
-	{FID_ACCELERATION, (message_handler_func_t)NULL}, \
-	{FID_MAGNETIC_FIELD, (message_handler_func_t)NULL}, \
-	{FID_ANGULAR_VELOCITY, (message_handler_func_t)NULL}, \
-	{FID_TEMPERATURE, (message_handler_func_t)NULL}, \
-	{FID_ORIENTATION, (message_handler_func_t)NULL}, \
-	{FID_LINEAR_ACCELERATION, (message_handler_func_t)NULL}, \
-	{FID_GRAVITY_VECTOR, (message_handler_func_t)NULL}, \
-	{FID_QUATERNION, (message_handler_func_t)NULL}, \
-	{FID_ALL_DATA, (message_handler_func_t)NULL},
+#define FID_SET_ACQUISITION_MODE 41
+#define FID_GET_ACQUISITION_MODE 42
+#define FID_GET_ACQUISITION_STATISTICS 43
+#define FID_SET_BUFFER_CONFIGURATION 44
+#define FID_GET_BUFFER_CONFIGURATION 45
+#define FID_GET_BUFFERED_SAMPLES 46
+#define FID_BUFFERED_SAMPLES 47
+#define FID_SET_CHANNEL_SAMPLE_PERIOD 48
+#define FID_GET_CHANNEL_SAMPLE_PERIOD 49
+#define FID_SET_ACQUISITION_PERIOD 50
+#define FID_GET_ACQUISITION_PERIOD 51
+#define FID_SET_OPERATION_MODE 52
+#define FID_GET_OPERATION_MODE 53
+#define FID_SET_SENSOR_CONFIGURATION 54
+#define FID_GET_SENSOR_CONFIGURATION 55
+#define FID_SET_COMPACT_STREAM_CONFIGURATION 56
+#define FID_GET_COMPACT_STREAM_CONFIGURATION 57
+#define FID_COMPACT_STREAM 58
+#define FID_SET_CHANNEL_DATA_CONFIGURATION 59
+#define FID_GET_CHANNEL_DATA_CONFIGURATION 60
+#define FID_CHANNEL_DATA 61
+#define FID_SET_CALLBACK_COALESCING 62
+#define FID_GET_CALLBACK_COALESCING 63
+#define FID_CALLBACK_FRAME 64
+#define FID_SET_SAMPLE_INFO 65
+#define FID_GET_SAMPLE_INFO 66
+#define FID_SET_CALLBACK_THRESHOLD 67
+#define FID_GET_CALLBACK_THRESHOLD 68
+#define FID_SET_MOTION_CONFIGURATION 69
+#define FID_GET_MOTION_CONFIGURATION 70
+#define FID_MOTION_EVENT 71
+#define FID_SET_IDLE_POLICY 72
+#define FID_GET_IDLE_POLICY 73
+#define FID_GET_IDLE_STATUS 74
+#define FID_GET_PERFORMANCE_STATISTICS 75
+#define FID_RESET_PERFORMANCE_STATISTICS 76
+#define FID_GET_LATENCY_HISTOGRAM 77
+#define FID_RESET_LATENCY_HISTOGRAM 78
+#define FID_SET_CALLBACK_PERIODS 79
+#define FID_GET_CALLBACK_PERIODS 80
+#define FID_GET_CHANNEL_DATA 81
+#define FID_CALIBRATION_SAVED 82
+#define FID_SET_CALIBRATION_CONFIGURATION 83
+#define FID_GET_CALIBRATION_CONFIGURATION 84
+#define FID_CALIBRATION_STATUS_CHANGED 85
+
+#define FID_LAST_USER FID_CALIBRATION_STATUS_CHANGED
+
+
+// All IMU messages in FID order. The list has to be dense (one entry for
+// every FID from 1 to FID_LAST_USER, NULL for callbacks), so that the
+// handler of a FID is found by its position. This is checked at compile
+// time in communication.c.
+#define COM_MESSAGES_USER_LIST(X) \
+	X(FID_GET_ACCELERATION, get_acceleration) \
+	X(FID_GET_MAGNETIC_FIELD, get_magnetic_field) \
+	X(FID_GET_ANGULAR_VELOCITY, get_angular_velocity) \
+	X(FID_GET_TEMPERATURE, get_temperature) \
+	X(FID_GET_ORIENTATION, get_orientation) \
+	X(FID_GET_LINEAR_ACCELERATION, get_linear_acceleration) \
+	X(FID_GET_GRAVITY_VECTOR, get_gravity_vector) \
+	X(FID_GET_QUATERNION, get_quaternion) \
+	X(FID_GET_ALL_DATA, get_all_data) \
+	X(FID_LEDS_ON, leds_on) \
+	X(FID_LEDS_OFF, leds_off) \
+	X(FID_ARE_LEDS_ON, are_leds_on) \
+	X(FID_SAVE_CALIBRATION, save_calibration) \
+	X(FID_SET_ACCELERATION_PERIOD, set_acceleration_period) \
+	X(FID_GET_ACCELERATION_PERIOD, get_acceleration_period) \
+	X(FID_SET_MAGNETIC_FIELD_PERIOD, set_magnetic_field_period) \
+	X(FID_GET_MAGNETIC_FIELD_PERIOD, get_magnetic_field_period) \
+	X(FID_SET_ANGULAR_VELOCITY_PERIOD, set_angular_velocity_period) \
+	X(FID_GET_ANGULAR_VELOCITY_PERIOD, get_angular_velocity_period) \
+	X(FID_SET_TEMPERATURE_PERIOD, set_temperature_period) \
+	X(FID_GET_TEMPERATURE_PERIOD, get_temperature_period) \
+	X(FID_SET_ORIENTATION_PERIOD, set_orientation_period) \
+	X(FID_GET_ORIENTATION_PERIOD, get_orientation_period) \
+	X(FID_SET_LINEAR_ACCELERATION_PERIOD, set_linear_acceleration_period) \
+	X(FID_GET_LINEAR_ACCELERATION_PERIOD, get_linear_acceleration_period) \
+	X(FID_SET_GRAVITY_VECTOR_PERIOD, set_gravity_vector_period) \
+	X(FID_GET_GRAVITY_VECTOR_PERIOD, get_gravity_vector_period) \
+	X(FID_SET_QUATERNION_PERIOD, set_quaternion_period) \
+	X(FID_GET_QUATERNION_PERIOD, get_quaternion_period) \
+	X(FID_SET_ALL_DATA_PERIOD, set_all_data_period) \
+	X(FID_GET_ALL_DATA_PERIOD, get_all_data_period) \
+	X(FID_ACCELERATION, NULL) \
+	X(FID_MAGNETIC_FIELD, NULL) \
+	X(FID_ANGULAR_VELOCITY, NULL) \
+	X(FID_TEMPERATURE, NULL) \
+	X(FID_ORIENTATION, NULL) \
+	X(FID_LINEAR_ACCELERATION, NULL) \
+	X(FID_GRAVITY_VECTOR, NULL) \
+	X(FID_QUATERNION, NULL) \
+	X(FID_ALL_DATA, NULL) \
+	X(FID_SET_ACQUISITION_MODE, set_acquisition_mode) \
+	X(FID_GET_ACQUISITION_MODE, get_acquisition_mode) \
+	X(FID_GET_ACQUISITION_STATISTICS, get_acquisition_statistics) \
+	X(FID_SET_BUFFER_CONFIGURATION, set_buffer_configuration) \
+	X(FID_GET_BUFFER_CONFIGURATION, get_buffer_configuration) \
+	X(FID_GET_BUFFERED_SAMPLES, get_buffered_samples) \
+	X(FID_BUFFERED_SAMPLES, NULL) \
+	X(FID_SET_CHANNEL_SAMPLE_PERIOD, set_channel_sample_period) \
+	X(FID_GET_CHANNEL_SAMPLE_PERIOD, get_channel_sample_period) \
+	X(FID_SET_ACQUISITION_PERIOD, set_acquisition_period) \
+	X(FID_GET_ACQUISITION_PERIOD, get_acquisition_period) \
+	X(FID_SET_OPERATION_MODE, set_operation_mode) \
+	X(FID_GET_OPERATION_MODE, get_operation_mode) \
+	X(FID_SET_SENSOR_CONFIGURATION, set_sensor_configuration) \
+	X(FID_GET_SENSOR_CONFIGURATION, get_sensor_configuration) \
+	X(FID_SET_COMPACT_STREAM_CONFIGURATION, set_compact_stream_configuration) \
+	X(FID_GET_COMPACT_STREAM_CONFIGURATION, get_compact_stream_configuration) \
+	X(FID_COMPACT_STREAM, NULL) \
+	X(FID_SET_CHANNEL_DATA_CONFIGURATION, set_channel_data_configuration) \
+	X(FID_GET_CHANNEL_DATA_CONFIGURATION, get_channel_data_configuration) \
+	X(FID_CHANNEL_DATA, NULL) \
+	X(FID_SET_CALLBACK_COALESCING, set_callback_coalescing) \
+	X(FID_GET_CALLBACK_COALESCING, get_callback_coalescing) \
+	X(FID_CALLBACK_FRAME, NULL) \
+	X(FID_SET_SAMPLE_INFO, set_sample_info) \
+	X(FID_GET_SAMPLE_INFO, get_sample_info) \
+	X(FID_SET_CALLBACK_THRESHOLD, set_callback_threshold) \
+	X(FID_GET_CALLBACK_THRESHOLD, get_callback_threshold) \
+	X(FID_SET_MOTION_CONFIGURATION, set_motion_configuration) \
+	X(FID_GET_MOTION_CONFIGURATION, get_motion_configuration) \
+	X(FID_MOTION_EVENT, NULL) \
+	X(FID_SET_IDLE_POLICY, set_idle_policy) \
+	X(FID_GET_IDLE_POLICY, get_idle_policy) \
+	X(FID_GET_IDLE_STATUS, get_idle_status) \
+	X(FID_GET_PERFORMANCE_STATISTICS, get_performance_statistics) \
+	X(FID_RESET_PERFORMANCE_STATISTICS, reset_performance_statistics) \
+	X(FID_GET_LATENCY_HISTOGRAM, get_latency_histogram) \
+	X(FID_RESET_LATENCY_HISTOGRAM, reset_latency_histogram) \
+	X(FID_SET_CALLBACK_PERIODS, set_callback_periods) \
+	X(FID_GET_CALLBACK_PERIODS, get_callback_periods) \
+	X(FID_GET_CHANNEL_DATA, get_channel_data) \
+	X(FID_CALIBRATION_SAVED, NULL) \
+	X(FID_SET_CALIBRATION_CONFIGURATION, set_calibration_configuration) \
+	X(FID_GET_CALIBRATION_CONFIGURATION, get_calibration_configuration) \
+	X(FID_CALIBRATION_STATUS_CHANGED, NULL)
+
+#define COM_MESSAGE_USER_ENTRY(fid, handler) {fid, (message_handler_func_t)handler},
+#define COM_MESSAGES_USER COM_MESSAGES_USER_LIST(COM_MESSAGE_USER_ENTRY)
 
 typedef struct {
 	MessageHeader header;
@@ -437,6 +536,386 @@ typedef struct {
 	uint8_t calibration_status;
 } __attribute__((__packed__)) AllDataCallback;
 
+typedef struct {
+	MessageHeader header;
+	uint8_t mode;
+} __attribute__((__packed__)) SetAcquisitionMode;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetAcquisitionMode;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t mode;
+} __attribute__((__packed__)) GetAcquisitionModeReturn;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetAcquisitionStatistics;
+
+typedef struct {
+	MessageHeader header;
+	uint32_t samples_read;
+	uint32_t samples_missed;
+	uint32_t samples_duplicate;
+} __attribute__((__packed__)) GetAcquisitionStatisticsReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint8_t watermark;
+} __attribute__((__packed__)) SetBufferConfiguration;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetBufferConfiguration;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint8_t watermark;
+} __attribute__((__packed__)) GetBufferConfigurationReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t count;
+} __attribute__((__packed__)) GetBufferedSamples;
+
+// data holds sample_count samples back to back, each is the timestamp in µs
+// (uint32) followed by the values of the channels in channel_mask, packed
+// in channel order like in ChannelDataCallback
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint8_t sample_count;
+	uint16_t samples_lost;
+	uint8_t data[59]; // IMU_BUFFER_MESSAGE_DATA_SIZE
+} __attribute__((__packed__)) GetBufferedSamplesReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint8_t sample_count;
+	uint16_t samples_lost;
+	uint8_t data[59]; // IMU_BUFFER_MESSAGE_DATA_SIZE
+} __attribute__((__packed__)) BufferedSamplesCallback;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t channel;
+	uint32_t period;
+} __attribute__((__packed__)) SetChannelSamplePeriod;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t channel;
+} __attribute__((__packed__)) GetChannelSamplePeriod;
+
+typedef struct {
+	MessageHeader header;
+	uint32_t period;
+} __attribute__((__packed__)) GetChannelSamplePeriodReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t period;
+	uint32_t callback_period_min;
+} __attribute__((__packed__)) SetAcquisitionPeriod;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetAcquisitionPeriod;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t period;
+	uint32_t callback_period_min;
+} __attribute__((__packed__)) GetAcquisitionPeriodReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t mode;
+} __attribute__((__packed__)) SetOperationMode;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetOperationMode;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t mode;
+} __attribute__((__packed__)) GetOperationModeReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t accelerometer_range;
+	uint8_t accelerometer_bandwidth;
+	uint8_t gyroscope_range;
+	uint8_t gyroscope_bandwidth;
+	uint8_t magnetometer_rate;
+} __attribute__((__packed__)) SetSensorConfiguration;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetSensorConfiguration;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t accelerometer_range;
+	uint8_t accelerometer_bandwidth;
+	uint8_t gyroscope_range;
+	uint8_t gyroscope_bandwidth;
+	uint8_t magnetometer_rate;
+} __attribute__((__packed__)) GetSensorConfigurationReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint32_t period;
+	uint8_t keyframe_interval;
+} __attribute__((__packed__)) SetCompactStreamConfiguration;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetCompactStreamConfiguration;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint32_t period;
+	uint8_t keyframe_interval;
+} __attribute__((__packed__)) GetCompactStreamConfigurationReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t sequence;
+	uint8_t flags;
+	uint8_t data[62];
+} __attribute__((__packed__)) CompactStreamCallback;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint32_t period;
+} __attribute__((__packed__)) SetChannelDataConfiguration;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetChannelDataConfiguration;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	uint32_t period;
+} __attribute__((__packed__)) GetChannelDataConfigurationReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+	int16_t values[24]; // IMU_CHANNEL_VALUES_MAX
+} __attribute__((__packed__)) ChannelDataCallback;
+
+typedef struct {
+	MessageHeader header;
+	bool enable;
+} __attribute__((__packed__)) SetCallbackCoalescing;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetCallbackCoalescing;
+
+typedef struct {
+	MessageHeader header;
+	bool enable;
+} __attribute__((__packed__)) GetCallbackCoalescingReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t messages[64];
+} __attribute__((__packed__)) CallbackFrameCallback;
+
+typedef struct {
+	MessageHeader header;
+	bool enable;
+} __attribute__((__packed__)) SetSampleInfo;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetSampleInfo;
+
+typedef struct {
+	MessageHeader header;
+	bool enable;
+} __attribute__((__packed__)) GetSampleInfoReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t callback;
+	uint8_t mode;
+	uint16_t threshold;
+	uint32_t keepalive;
+} __attribute__((__packed__)) SetCallbackThreshold;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t callback;
+} __attribute__((__packed__)) GetCallbackThreshold;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t mode;
+	uint16_t threshold;
+	uint32_t keepalive;
+} __attribute__((__packed__)) GetCallbackThresholdReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t interrupts;
+	uint8_t any_motion_threshold;
+	uint8_t any_motion_duration;
+	uint8_t no_motion_threshold;
+	uint8_t no_motion_duration;
+	uint8_t high_g_threshold;
+	uint8_t high_g_duration;
+	uint8_t gyroscope_any_motion_threshold;
+} __attribute__((__packed__)) SetMotionConfiguration;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetMotionConfiguration;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t interrupts;
+	uint8_t any_motion_threshold;
+	uint8_t any_motion_duration;
+	uint8_t no_motion_threshold;
+	uint8_t no_motion_duration;
+	uint8_t high_g_threshold;
+	uint8_t high_g_duration;
+	uint8_t gyroscope_any_motion_threshold;
+} __attribute__((__packed__)) GetMotionConfigurationReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t events;
+	uint32_t timestamp;
+} __attribute__((__packed__)) MotionEventCallback;
+
+typedef struct {
+	MessageHeader header;
+	bool enable;
+	uint8_t power_mode;
+	uint32_t timeout;
+} __attribute__((__packed__)) SetIdlePolicy;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetIdlePolicy;
+
+typedef struct {
+	MessageHeader header;
+	bool enable;
+	uint8_t power_mode;
+	uint32_t timeout;
+} __attribute__((__packed__)) GetIdlePolicyReturn;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetIdleStatus;
+
+typedef struct {
+	MessageHeader header;
+	bool idle;
+	uint32_t wake_count;
+	uint32_t wake_latency; // in µs, of the last wake up
+} __attribute__((__packed__)) GetIdleStatusReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t stage;
+} __attribute__((__packed__)) GetPerformanceStatistics;
+
+typedef struct {
+	MessageHeader header;
+	uint32_t count;
+	uint32_t min;  // in cycles of the 64MHz core clock
+	uint32_t max;
+	uint32_t mean;
+	uint32_t overruns; // ticks longer than 1ms, 0 for the other stages
+} __attribute__((__packed__)) GetPerformanceStatisticsReturn;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) ResetPerformanceStatistics;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t callback;
+} __attribute__((__packed__)) GetLatencyHistogram;
+
+typedef struct {
+	MessageHeader header;
+	uint32_t buckets[8];
+} __attribute__((__packed__)) GetLatencyHistogramReturn;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) ResetLatencyHistogram;
+
+typedef struct {
+	MessageHeader header;
+	uint32_t periods[11]; // indexed by IMU_PERIOD_TYPE_*
+} __attribute__((__packed__)) SetCallbackPeriods;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetCallbackPeriods;
+
+typedef struct {
+	MessageHeader header;
+	uint32_t periods[11];
+} __attribute__((__packed__)) GetCallbackPeriodsReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint16_t channel_mask;
+} __attribute__((__packed__)) GetChannelData;
+
+typedef struct {
+	MessageHeader header;
+	uint32_t sequence;
+	uint16_t channel_mask;
+	int16_t values[24]; // IMU_CHANNEL_VALUES_MAX
+} __attribute__((__packed__)) GetChannelDataReturn;
+
+typedef struct {
+	MessageHeader header;
+	bool success;
+} __attribute__((__packed__)) CalibrationSavedCallback;
+
+typedef struct {
+	MessageHeader header;
+	bool auto_save;
+	bool status_changed_callback;
+} __attribute__((__packed__)) SetCalibrationConfiguration;
+
+typedef struct {
+	MessageHeader header;
+} __attribute__((__packed__)) GetCalibrationConfiguration;
+
+typedef struct {
+	MessageHeader header;
+	bool auto_save;
+	bool status_changed_callback;
+} __attribute__((__packed__)) GetCalibrationConfigurationReturn;
+
+typedef struct {
+	MessageHeader header;
+	uint8_t calibration_status;
+} __attribute__((__packed__)) CalibrationStatusChangedCallback;
+
 void get_acceleration(const ComType com, const GetAcceleration *data);
 void get_magnetic_field(const ComType com, const GetMagneticField *data);
 void get_angular_velocity(const ComType com, const GetAngularVelocity *data);
@@ -468,5 +947,43 @@ void set_quaternion_period(const ComType com, const SetQuaternionPeriod *data);
 void get_quaternion_period(const ComType com, const GetQuaternionPeriod *data);
 void set_all_data_period(const ComType com, const SetAllDataPeriod *data);
 void get_all_data_period(const ComType com, const GetAllDataPeriod *data);
+void set_acquisition_mode(const ComType com, const SetAcquisitionMode *data);
+void get_acquisition_mode(const ComType com, const GetAcquisitionMode *data);
+void get_acquisition_statistics(const ComType com, const GetAcquisitionStatistics *data);
+void set_buffer_configuration(const ComType com, const SetBufferConfiguration *data);
+void get_buffer_configuration(const ComType com, const GetBufferConfiguration *data);
+void get_buffered_samples(const ComType com, const GetBufferedSamples *data);
+void set_channel_sample_period(const ComType com, const SetChannelSamplePeriod *data);
+void get_channel_sample_period(const ComType com, const GetChannelSamplePeriod *data);
+void set_acquisition_period(const ComType com, const SetAcquisitionPeriod *data);
+void get_acquisition_period(const ComType com, const GetAcquisitionPeriod *data);
+void set_operation_mode(const ComType com, const SetOperationMode *data);
+void get_operation_mode(const ComType com, const GetOperationMode *data);
+void set_sensor_configuration(const ComType com, const SetSensorConfiguration *data);
+void get_sensor_configuration(const ComType com, const GetSensorConfiguration *data);
+void set_compact_stream_configuration(const ComType com, const SetCompactStreamConfiguration *data);
+void get_compact_stream_configuration(const ComType com, const GetCompactStreamConfiguration *data);
+void set_channel_data_configuration(const ComType com, const SetChannelDataConfiguration *data);
+void get_channel_data_configuration(const ComType com, const GetChannelDataConfiguration *data);
+void set_callback_coalescing(const ComType com, const SetCallbackCoalescing *data);
+void get_callback_coalescing(const ComType com, const GetCallbackCoalescing *data);
+void set_sample_info(const ComType com, const SetSampleInfo *data);
+void get_sample_info(const ComType com, const GetSampleInfo *data);
+void set_callback_threshold(const ComType com, const SetCallbackThreshold *data);
+void get_callback_threshold(const ComType com, const GetCallbackThreshold *data);
+void set_motion_configuration(const ComType com, const SetMotionConfiguration *data);
+void get_motion_configuration(const ComType com, const GetMotionConfiguration *data);
+void set_idle_policy(const ComType com, const SetIdlePolicy *data);
+void get_idle_policy(const ComType com, const GetIdlePolicy *data);
+void get_idle_status(const ComType com, const GetIdleStatus *data);
+void get_performance_statistics(const ComType com, const GetPerformanceStatistics *data);
+void reset_performance_statistics(const ComType com, const ResetPerformanceStatistics *data);
+void get_latency_histogram(const ComType com, const GetLatencyHistogram *data);
+void reset_latency_histogram(const ComType com, const ResetLatencyHistogram *data);
+void set_callback_periods(const ComType com, const SetCallbackPeriods *data);
+void get_callback_periods(const ComType com, const GetCallbackPeriods *data);
+void get_channel_data(const ComType com, const GetChannelData *data);
+void set_calibration_configuration(const ComType com, const SetCalibrationConfiguration *data);
+void get_calibration_configuration(const ComType com, const GetCalibrationConfiguration *data);
 
 #endif
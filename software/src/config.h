@@ -142,6 +142,7 @@
 #define PRIORITY_EEPROM_SLAVE_TWI1   6
 #define PRIORITY_STACK_SLAVE_SPI     6
 #define PRIORITY_PROFILING_TC0       0
+#define PRIORITY_IMU_TWI0            6
 
 // ************** BRICKLET SETTINGS **************
 
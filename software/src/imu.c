@@ -28,6 +28,7 @@
 #include "bricklib/logging/logging.h"
 
 #include "bricklib/drivers/pio/pio.h"
+#include "bricklib/drivers/pio/pio_it.h"
 #include "bricklib/drivers/twi/twi.h"
 #include "bricklib/drivers/twi/twid.h"
 #include "bricklib/drivers/async/async.h"
@@ -41,12 +42,18 @@
 #include "bricklib/utility/sqrt.h"
 #include "bricklib/utility/mutex.h"
 #include "bricklib/drivers/flash/flashd.h"
+#include "bricklib/drivers/efc/efc.h"
+#include "bricklib/drivers/crc/crc.h"
+#include "bricklib/free_rtos/include/FreeRTOS.h"
+#include "bricklib/free_rtos/include/task.h"
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
 
 uint32_t imu_period[IMU_PERIOD_NUM] = {0};
+uint32_t imu_period_min = 0;
 uint32_t imu_period_counter[IMU_PERIOD_NUM] = {0};
 
 bool imu_use_leds = false;
@@ -74,20 +81,174 @@ bool pins_led_is_pwm[] = {true,
                           false,
                           true};
 
-SensorData sensor_data = {0};
-uint8_t update_sensor_counter = 0;
+// Double buffered sensor data. The buffer with index (sequence & 1) is the
+// one that can be read, the other one is written by the next TWI transfer.
+// See imu_get_sensor_data for the read side.
+SensorData sensor_data_buffer[2] = {{0}};
+uint32_t sensor_data_timestamp[2] = {0};
+volatile uint32_t sensor_data_sequence = 0;
+bool imu_sample_info = false;
+uint16_t update_sensor_counter = 0;
+uint8_t imu_operation_mode = IMU_OPERATION_MODE_NDOF;
+
+// Power on defaults of the BNO055, see Table 3-8
+IMUSensorConfiguration imu_sensor_configuration = {
+	RANGE_ACCELEROMETER_4G,
+	BANDWIDTH_ACCELEROMETER_62_5HZ,
+	RANGE_GYROSCOPE_2000DPS,
+	BANDWIDTH_GYROSCOPE_32HZ,
+	DATA_RATE_MAGNETOMETER_20HZ,
+	IMU_OPERATION_MODE_NDOF,
+	0
+};
+uint16_t imu_acquisition_period = IMU_ACQUISITION_PERIOD_DEFAULT;
+
+Pin pin_bno_int = PIN_BNO_INT;
+uint8_t imu_acquisition_mode = IMU_ACQUISITION_MODE_POLL;
+volatile bool imu_data_ready = false;
+volatile bool imu_int_status_pending = false;
+volatile uint32_t imu_int_timestamp = 0;
+IMUMotionConfiguration imu_motion_configuration = {0, 20, 0, 10, 5, 192, 15, 4};
+uint8_t imu_motion_events = 0;
+uint32_t imu_motion_timestamp = 0;
+
+bool imu_idle_enable = false;
+uint8_t imu_idle_power_mode = IMU_POWER_MODE_LOW_POWER;
+uint32_t imu_idle_timeout = IMU_IDLE_TIMEOUT_DEFAULT;
+bool imu_idle = false;
+bool imu_wake_pending = false;
+uint32_t imu_last_activity = 0;
+uint32_t imu_wake_start = 0;
+uint32_t imu_wake_latency = 0;
+uint32_t imu_wake_count = 0;
+
+volatile uint8_t imu_power_switch_state = IMU_POWER_SWITCH_IDLE;
+uint8_t imu_power_switch_mode = IMU_POWER_MODE_NORMAL;
+uint32_t imu_power_switch_time = 0;
+uint32_t imu_power_switch_request_time = 0;
+
+// Set while somebody switches the BNO055 out of its operation mode, see
+// imu_mode_try_take
+volatile bool imu_mode_busy = false;
+uint32_t imu_samples_read = 0;
+uint32_t imu_samples_missed = 0;
+uint32_t imu_samples_duplicate = 0;
+uint32_t imu_samples_last_timestamp = 0;
+bool imu_samples_continuous = false;
+
+// Output data periods in µs of the sensors in the non-fusion modes, indexed
+// with the bandwidth/data rate of the sensor configuration. The
+// accelerometer outputs data with twice its bandwidth.
+const uint32_t imu_output_period_acc[8] = {64000, 32000, 16000, 8000, 4000, 2000, 1000, 500};
+const uint32_t imu_output_period_gyr[8] = {500, 500, 1000, 2500, 5000, 10000, 5000, 10000};
+const uint32_t imu_output_period_mag[8] = {500000, 166667, 125000, 100000, 66667, 50000, 40000, 33333};
+
+uint8_t imu_buffer[IMU_BUFFER_SIZE];
+uint16_t imu_buffer_start = 0; // in samples
+uint16_t imu_buffer_count = 0;
+uint16_t imu_buffer_capacity = 0;
+uint16_t imu_buffer_samples_lost = 0;
+uint16_t imu_buffer_channels = 0; // 0: buffer disabled
+uint8_t imu_buffer_sample_size = 0;
+uint8_t imu_buffer_watermark = 0;
+
+uint16_t imu_compact_channels = IMU_CHANNEL_MASK_ALL;
+uint8_t imu_compact_keyframe_interval = IMU_COMPACT_KEYFRAME_INTERVAL_DEFAULT;
+uint8_t imu_compact_sequence = 0;
+uint8_t imu_compact_since_keyframe = IMU_COMPACT_KEYFRAME_INTERVAL_DEFAULT;
+int16_t imu_compact_last_values[IMU_CHANNEL_VALUES_MAX];
+
+uint16_t imu_channel_data_channels = (1 << IMU_CHANNEL_QUA) | (1 << IMU_CHANNEL_LIA);
+
+IMUThreshold imu_threshold[IMU_THRESHOLD_NUM] = {{0}};
+
+IMUPerfStatistics imu_perf[IMU_PERF_STAGE_NUM];
+uint32_t imu_perf_send_cycles = 0;
+
+bool imu_callback_coalescing = false;
+uint8_t imu_callback_frame[IMU_CALLBACK_FRAME_SIZE];
+uint8_t imu_callback_frame_length = 0;
+uint8_t imu_callback_frame_count = 0;
+uint8_t imu_callback_frame_type[IMU_CALLBACK_FRAME_MESSAGES_MAX];
+uint32_t imu_callback_frame_timestamp[IMU_CALLBACK_FRAME_MESSAGES_MAX];
+
+// Upper bucket limits in µs, the last bucket has no limit
+const uint32_t imu_latency_bucket_limit[IMU_LATENCY_BUCKET_NUM - 1] = {
+	1000, 2000, 5000, 10000, 20000, 50000, 100000
+};
+uint32_t imu_latency_histogram[IMU_PERIOD_NUM][IMU_LATENCY_BUCKET_NUM] = {{0}};
+
+// Position of the channels in SensorData, indexed by IMU_CHANNEL_*
+const IMUReadWindow imu_channel_window[IMU_CHANNEL_NUM] = {
+	{offsetof(SensorData, acc_x),              6},
+	{offsetof(SensorData, mag_x),              6},
+	{offsetof(SensorData, gyr_x),              6},
+	{offsetof(SensorData, temperature),        1},
+	{offsetof(SensorData, eul_heading),        6},
+	{offsetof(SensorData, lia_x),              6},
+	{offsetof(SensorData, grv_x),              6},
+	{offsetof(SensorData, qua_w),              8},
+	{offsetof(SensorData, calibration_status), 1}
+};
+
+const uint8_t imu_channel_register_order[IMU_CHANNEL_NUM] = {
+	IMU_CHANNEL_ACC,
+	IMU_CHANNEL_MAG,
+	IMU_CHANNEL_ANG,
+	IMU_CHANNEL_ORI,
+	IMU_CHANNEL_QUA,
+	IMU_CHANNEL_LIA,
+	IMU_CHANNEL_GRV,
+	IMU_CHANNEL_TMP,
+	IMU_CHANNEL_CAL
+};
+
+uint32_t imu_channel_sample_period[IMU_CHANNEL_NUM] = {0, 0, 0, 1000, 0, 0, 0, 0, 0};
+const uint8_t imu_channel_value_num[IMU_CHANNEL_NUM] = {3, 3, 3, 1, 3, 3, 3, 4, 1}; // see imu_get_channel_values
+uint32_t imu_channel_last_read[IMU_CHANNEL_NUM] = {0};
+uint32_t imu_channel_last_use[IMU_CHANNEL_NUM] = {0};
+uint16_t imu_channel_use_mask = 0; // channels that were requested at least once
+volatile uint16_t imu_channel_requested = 0; // stale channels a getter waits for
 
 uint32_t cal_counter = 0;
 
-const IMUCalibrationConst *imu_calibration_in_flash = (const IMUCalibrationConst*)IMU_CALIBRATION_ADDRESS;
+volatile uint8_t imu_calibration_save_state = IMU_CALIBRATION_SAVE_IDLE;
+uint32_t imu_calibration_save_time = 0;
+IMUCalibration imu_calibration_save_data;
+bool imu_calibration_save_success = false;
+bool imu_calibration_save_done = false;
+bool imu_calibration_save_automatic = false;
+bool imu_calibration_save_skip = false;
+
+bool imu_calibration_auto_save = false;
+bool imu_calibration_status_callback_enable = false;
+uint8_t imu_calibration_status = 0;
+bool imu_calibration_status_changed = false;
+uint32_t imu_calibration_auto_save_time = 0;
+bool imu_calibration_auto_save_done = false;
+
+uint8_t imu_calibration_slot = IMU_CALIBRATION_SLOT_NONE;
+uint32_t imu_calibration_sequence = 0;
+// Page image for imu_calibration_log_write, only the save state machine
+// writes the log, so one static buffer is enough (keeps 256 byte off the
+// tick task stack)
+uint32_t imu_calibration_page[IFLASH_PAGE_SIZE/sizeof(uint32_t)];
 
 void tick_task(const uint8_t tick_type) {
 	static int8_t message_counter = 0;
+	static uint8_t blink_counter = 0;
+	const uint32_t tick_start = DWT->CYCCNT;
 
 	if(tick_type == TICK_TASK_TYPE_CALCULATION) {
+		imu_calibration_save_tick();
+		imu_power_switch_tick();
 		update_sensor_data();
 
-		if(update_sensor_counter == 5) {
+		// The LEDs are updated with a fixed period, independent of the
+		// acquisition period
+		blink_counter++;
+		if(blink_counter >= IMU_BLINK_PERIOD) {
+			blink_counter = 0;
 			imu_blinkenlights();
 		}
 
@@ -110,22 +271,73 @@ void tick_task(const uint8_t tick_type) {
 		}
 
 		for(uint8_t i = 0; i < IMU_PERIOD_NUM; i++) {
-			if((imu_period[i] != 0) &&
-			   (imu_period[i] <= imu_period_counter[i])) {
+			const uint32_t period = imu_get_effective_period(i);
+			if((period != 0) &&
+			   (period <= imu_period_counter[i])) {
 				// Test if we are totally out of time (lost a whole
 				// period), in this case we don't send the callback again.
 				// This is needed for the wireless extensions
-				if(imu_period[i]*2 <= imu_period_counter[i]) {
-					imu_period_counter[i] = imu_period[i];
+				if(period*2 <= imu_period_counter[i]) {
+					imu_period_counter[i] = period;
 				}
+
+				// Don't send values that the current operation mode
+				// does not provide
+				if(!(imu_period_channel_mask(i) & imu_get_valid_channels(imu_operation_mode))) {
+					imu_period_counter[i] -= period;
+					continue;
+				}
+
+				const uint32_t start = DWT->CYCCNT;
+				const uint32_t send_cycles = imu_perf_send_cycles;
 				make_period_callback(i);
+				imu_perf_record(IMU_PERF_STAGE_PACKET_BUILD,
+				                DWT->CYCCNT - start - (imu_perf_send_cycles - send_cycles));
 			}
 		}
+
+		imu_buffer_callback();
+		imu_motion_callback();
+		imu_calibration_status_changed_callback();
+		imu_calibration_saved_callback();
+		imu_flush_callbacks();
+	}
+
+	imu_perf_record(tick_type == TICK_TASK_TYPE_CALCULATION ? IMU_PERF_STAGE_TICK_CALCULATION : IMU_PERF_STAGE_TICK_MESSAGE,
+	                DWT->CYCCNT - tick_start);
+}
+
+// Sets all callback periods at once. The counters are reset together, so
+// callbacks with the same period are sent in the same tick.
+void imu_set_periods(const uint32_t *periods) {
+	taskENTER_CRITICAL();
+	for(uint8_t i = 0; i < IMU_PERIOD_NUM; i++) {
+		imu_period[i] = periods[i];
+		imu_period_counter[i] = 0;
 	}
+	taskEXIT_CRITICAL();
+}
+
+// Callback periods below imu_period_min are raised to it, a callback
+// that is faster than the acquisition would only repeat old data
+uint32_t imu_get_effective_period(const uint8_t type) {
+	if(imu_period[type] == 0) {
+		return 0;
+	}
+
+	return MAX(imu_period[type], imu_period_min);
 }
 
 void make_period_callback(const uint8_t type) {
-	imu_period_counter[type] -= imu_period[type];
+	imu_period_counter[type] -= imu_get_effective_period(type);
+
+	SensorData sensor_data;
+	SampleInfo info;
+	imu_get_sensor_data(&sensor_data, &info);
+
+	if(!imu_threshold_check(type, &sensor_data)) {
+		return;
+	}
 
 	switch(type) {
 		case IMU_PERIOD_TYPE_ACC: {
@@ -135,9 +347,7 @@ void make_period_callback(const uint8_t type) {
 			ac.y = sensor_data.acc_y;
 			ac.z = sensor_data.acc_z;
 
-			send_blocking_with_timeout(&ac,
-			                           sizeof(AccelerationCallback),
-			                           com_info.current);
+			imu_send_callback(&ac, sizeof(AccelerationCallback), &info, type);
 			break;
 		}
 
@@ -148,9 +358,7 @@ void make_period_callback(const uint8_t type) {
 			mfc.y = sensor_data.mag_y;
 			mfc.z = sensor_data.mag_z;
 
-			send_blocking_with_timeout(&mfc,
-			                           sizeof(MagneticFieldCallback),
-			                           com_info.current);
+			imu_send_callback(&mfc, sizeof(MagneticFieldCallback), &info, type);
 			break;
 		}
 
@@ -161,20 +369,16 @@ void make_period_callback(const uint8_t type) {
 			avc.y = sensor_data.gyr_y;
 			avc.z = sensor_data.gyr_z;
 
-			send_blocking_with_timeout(&avc,
-			                           sizeof(AngularVelocityCallback),
-			                           com_info.current);
+			imu_send_callback(&avc, sizeof(AngularVelocityCallback), &info, type);
 			break;
 		}
 
 		case IMU_PERIOD_TYPE_TMP: {
 			TemperatureCallback tc;
-			com_make_default_header(&tc, com_info.uid, sizeof(AngularVelocityCallback), FID_TEMPERATURE);
+			com_make_default_header(&tc, com_info.uid, sizeof(TemperatureCallback), FID_TEMPERATURE);
 			tc.temperature = sensor_data.temperature;
 
-			send_blocking_with_timeout(&tc,
-			                           sizeof(TemperatureCallback),
-			                           com_info.current);
+			imu_send_callback(&tc, sizeof(TemperatureCallback), &info, type);
 			break;
 		}
 
@@ -185,9 +389,7 @@ void make_period_callback(const uint8_t type) {
 			oc.pitch   = sensor_data.eul_pitch;
 			oc.heading = sensor_data.eul_heading;
 
-			send_blocking_with_timeout(&oc,
-			                           sizeof(OrientationCallback),
-			                           com_info.current);
+			imu_send_callback(&oc, sizeof(OrientationCallback), &info, type);
 			break;
 		}
 
@@ -198,9 +400,7 @@ void make_period_callback(const uint8_t type) {
 			lac.y = sensor_data.lia_y;
 			lac.z = sensor_data.lia_z;
 
-			send_blocking_with_timeout(&lac,
-			                           sizeof(LinearAccelerationCallback),
-			                           com_info.current);
+			imu_send_callback(&lac, sizeof(LinearAccelerationCallback), &info, type);
 			break;
 		}
 
@@ -211,9 +411,7 @@ void make_period_callback(const uint8_t type) {
 			gvc.y = sensor_data.grv_y;
 			gvc.z = sensor_data.grv_z;
 
-			send_blocking_with_timeout(&gvc,
-			                           sizeof(GravityVectorCallback),
-			                           com_info.current);
+			imu_send_callback(&gvc, sizeof(GravityVectorCallback), &info, type);
 			break;
 		}
 
@@ -225,9 +423,7 @@ void make_period_callback(const uint8_t type) {
 			qc.z = sensor_data.qua_z;
 			qc.w = sensor_data.qua_w;
 
-			send_blocking_with_timeout(&qc,
-			                           sizeof(QuaternionCallback),
-			                           com_info.current);
+			imu_send_callback(&qc, sizeof(QuaternionCallback), &info, type);
 			break;
 		}
 
@@ -235,11 +431,19 @@ void make_period_callback(const uint8_t type) {
 			AllDataCallback adc;
 			com_make_default_header(&adc, com_info.uid, sizeof(AllDataCallback), FID_ALL_DATA);
 
-			memcpy(&adc.acceleration, &sensor_data, sizeof(SensorData));
+			memcpy(adc.acceleration, &sensor_data, sizeof(SensorData));
 
-			send_blocking_with_timeout(&adc,
-			                           sizeof(AllDataCallback),
-			                           com_info.current);
+			imu_send_callback(&adc, sizeof(AllDataCallback), &info, type);
+			break;
+		}
+
+		case IMU_PERIOD_TYPE_CMP: {
+			make_compact_stream_callback(&sensor_data, &info);
+			break;
+		}
+
+		case IMU_PERIOD_TYPE_MSK: {
+			make_channel_data_callback(&sensor_data, &info);
 			break;
 		}
 	}
@@ -328,6 +532,9 @@ void imu_blinkenlights(void) {
 		return;
 	}
 
+	SensorData sensor_data;
+	imu_get_sensor_data(&sensor_data, NULL);
+
 	PWMC_SetDutyCycle(PWM, 0,
 	                  blink_lookup[(BETWEEN(-1000, sensor_data.acc_x, 1000) +
 	                                1000)/50]);
@@ -371,167 +578,1845 @@ void imu_blinkenlights(void) {
 }
 
 void update_sensor_data(void) {
-	update_sensor_counter++;
-	// Can we use interrupt pin instead of counter?
-	if(update_sensor_counter >= 10) {
-		bmo_read_registers(REG_ACC_DATA_X_LSB, (uint8_t*)&sensor_data, sizeof(SensorData));
-		update_sensor_counter = 0;
+	if(update_sensor_counter < UINT16_MAX) {
+		update_sensor_counter++;
+	}
+
+	// A setter of the message task or the power switch is switching the
+	// mode, the BNO055 must not be accessed until it is ready. The
+	// calibration save owns the mode for longer, it is handled below.
+	if(imu_mode_busy && (imu_calibration_save_state == IMU_CALIBRATION_SAVE_IDLE)) {
+		imu_samples_continuous = false;
+		return;
+	}
+
+	// The motion interrupts may have been disabled since the edge, then
+	// the status is of no interest, but the line still has to be reset
+	const bool int_status = imu_int_status_pending;
+	if(int_status) {
+		imu_int_status_pending = false;
+		if(imu_motion_configuration.interrupts != 0) {
+			imu_read_interrupt_status();
+		}
+	}
+
+	// The calibration save owns the mode, no idle transitions meanwhile
+	if(imu_calibration_save_state == IMU_CALIBRATION_SAVE_IDLE) {
+		imu_update_idle_state(xTaskGetTickCount()*portTICK_RATE_MS);
+	}
+
+	// Channels that a getter waits for are read right away
+	const uint16_t requested = imu_channel_requested;
+	bool read = false;
+	if(imu_idle || imu_calibration_save_in_config_mode()) {
+		imu_samples_continuous = false;
+	} else if(imu_acquisition_mode == IMU_ACQUISITION_MODE_INTERRUPT) {
+		// Read as soon as the BNO055 signals new data. If the INT line stays
+		// quiet (BNO055 firmware without data ready interrupt) we fall back
+		// to polling with twice the period, otherwise we would never get
+		// any data.
+		read = imu_data_ready ||
+		       update_sensor_counter >= imu_acquisition_period*2 ||
+		       requested != 0;
+	} else {
+		read = update_sensor_counter >= imu_acquisition_period || requested != 0;
+	}
+
+	// The INT line is latched, we have to reset it to get the next edge.
+	// That includes the fallback poll: If a data ready edge got lost, the
+	// line stays high and no edge would ever come again. The reset clears
+	// the interrupt status, so it comes after INT_STA was read and before
+	// the data, and only once per tick.
+	if(int_status || (read && (imu_acquisition_mode == IMU_ACQUISITION_MODE_INTERRUPT))) {
+		imu_reset_int();
+	}
+
+	if(!read) {
+		return;
+	}
+
+	imu_data_ready = false;
+	update_sensor_counter = 0;
+
+	const uint32_t time = xTaskGetTickCount()*portTICK_RATE_MS;
+	const uint16_t valid_channels = imu_get_valid_channels(imu_operation_mode);
+	const uint16_t channels = (imu_get_due_channels(time) | requested) & valid_channels;
+	if(channels == 0) {
+		imu_samples_continuous = false;
+		return;
+	}
+
+	IMUReadWindow windows[IMU_CHANNEL_NUM];
+	const uint8_t window_num = imu_plan_reads(channels, windows);
+
+	const uint32_t sequence = sensor_data_sequence;
+	SensorData *sensor_data_front = &sensor_data_buffer[sequence & 1];
+	SensorData *sensor_data_back  = &sensor_data_buffer[(sequence + 1) & 1];
+
+	// Channels that are not read keep their last value, channels that are
+	// not available in the current operation mode are zero
+	*sensor_data_back = *sensor_data_front;
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if(!(valid_channels & (1 << i))) {
+			memset(((uint8_t*)sensor_data_back) + imu_channel_window[i].offset, 0, imu_channel_window[i].length);
+		}
+	}
+
+	bool duplicate = true;
+	for(uint8_t i = 0; i < window_num; i++) {
+		uint8_t *back  = ((uint8_t*)sensor_data_back)  + windows[i].offset;
+		uint8_t *front = ((uint8_t*)sensor_data_front) + windows[i].offset;
+		if(!bmo_read_registers_async(REG_ACC_DATA_X_LSB + windows[i].offset, back, windows[i].length)) {
+			// Keep the previous sample published, the back buffer is
+			// incomplete
+			return;
+		}
+
+		if(memcmp(back, front, windows[i].length) != 0) {
+			duplicate = false;
+		}
+	}
+
+	const uint32_t timestamp = imu_get_timestamp();
+	sensor_data_timestamp[(sequence + 1) & 1] = timestamp;
+
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if(channels & (1 << i)) {
+			imu_channel_last_read[i] = time;
+		}
+	}
+
+	imu_samples_read++;
+	imu_count_missed_samples(channels, timestamp);
+	if(duplicate) {
+		imu_samples_duplicate++;
+	}
+
+	// The wake up is done when the BNO055 delivers new data again
+	if(imu_wake_pending && !duplicate) {
+		imu_wake_pending = false;
+		imu_wake_latency = timestamp - imu_wake_start;
+	}
+
+	// Swap front and back buffer
+	__DMB();
+	sensor_data_sequence = sequence + 1;
+
+	taskENTER_CRITICAL();
+	imu_channel_requested &= ~channels;
+	taskEXIT_CRITICAL();
+
+	// Channels with a longer sample period (temperature) are buffered
+	// with their last value
+	if(channels & imu_buffer_channels) {
+		imu_buffer_push(sensor_data_back, timestamp);
+	}
+
+	if(channels & (1 << IMU_CHANNEL_CAL)) {
+		imu_calibration_update_status(sensor_data_back->calibration_status, time);
 	}
 }
 
-void bmo_write_register(const uint8_t reg, uint8_t const value) {
-	mutex_take(mutex_twi_bricklet, MUTEX_BLOCKING);
-    TWID_Write(&twid,
-    		   BMO055_ADDRESS_HIGH,
-    		   reg,
-               1,
-               (uint8_t *)&value,
-               1,
-               NULL);
-	mutex_give(mutex_twi_bricklet);
+// Returns the output data period of the BNO055 in µs: The fusion output
+// rate in the fusion modes, otherwise the rate of the fastest sensor that
+// is enabled in the operation mode.
+uint32_t imu_get_output_period(void) {
+	if(imu_operation_mode >= IMU_OPERATION_MODE_IMU) {
+		return IMU_ACQUISITION_PERIOD_FUSION*1000;
+	}
+
+	const uint16_t channels = imu_get_valid_channels(imu_operation_mode);
+	uint32_t period = UINT32_MAX;
+	if(channels & (1 << IMU_CHANNEL_ACC)) {
+		period = MIN(period, imu_output_period_acc[imu_sensor_configuration.accelerometer_bandwidth & 7]);
+	}
+	if(channels & (1 << IMU_CHANNEL_ANG)) {
+		period = MIN(period, imu_output_period_gyr[imu_sensor_configuration.gyroscope_bandwidth & 7]);
+	}
+	if(channels & (1 << IMU_CHANNEL_MAG)) {
+		period = MIN(period, imu_output_period_mag[imu_sensor_configuration.magnetometer_rate & 7]);
+	}
+
+	return period == UINT32_MAX ? IMU_ACQUISITION_PERIOD_FUSION*1000 : period;
 }
 
-void bmo_write_registers(const uint8_t reg, const uint8_t *data, const uint8_t length) {
-	mutex_take(mutex_twi_bricklet, MUTEX_BLOCKING);
-    TWID_Write(&twid,
-    		   BMO055_ADDRESS_HIGH,
-    		   reg,
-               1,
-               (uint8_t *)data,
-               length,
-               NULL);
-	mutex_give(mutex_twi_bricklet);
+// Counts the samples that the BNO055 produced but that were never read.
+// The INT line is latched until it is reset, data ready events in between
+// don't produce an edge. Instead we compare the time since the last read
+// with the output data period: Every whole output period that the read is
+// late adds one missed sample. A read is expected every output period in
+// the interrupt mode, every acquisition period in the poll mode and not
+// before the sample period of the channels that were read.
+void imu_count_missed_samples(const uint16_t channels, const uint32_t timestamp) {
+	if(imu_samples_continuous) {
+		const uint32_t output_period = imu_get_output_period();
+
+		uint32_t expected = output_period;
+		if(imu_acquisition_mode == IMU_ACQUISITION_MODE_POLL) {
+			expected = MAX(expected, imu_acquisition_period*1000);
+		}
+
+		uint32_t sample_period = UINT32_MAX;
+		for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+			if(channels & (1 << i)) {
+				sample_period = MIN(sample_period, imu_channel_sample_period[i]);
+			}
+		}
+		expected = MAX(expected, sample_period*1000);
+
+		const uint32_t elapsed = timestamp - imu_samples_last_timestamp;
+		if(elapsed >= expected + output_period) {
+			imu_samples_missed += (elapsed - expected)/output_period;
+		}
+	}
+
+	imu_samples_last_timestamp = timestamp;
+	imu_samples_continuous = true;
 }
 
-void bmo_read_registers(const uint8_t reg, uint8_t *data, const uint8_t length) {
-	mutex_take(mutex_twi_bricklet, MUTEX_BLOCKING);
-    TWID_Read(&twid,
-    		   BMO055_ADDRESS_HIGH,
-    		   reg,
-               1,
-               data,
-               length,
-               NULL);
-	mutex_give(mutex_twi_bricklet);
+// Returns the channels that somebody currently uses: Channels with an
+// enabled period callback, the buffered channel, channels that were
+// recently requested by a getter and the channels needed for the LEDs.
+uint16_t imu_get_active_channels(const uint32_t time) {
+	uint16_t channels = 0;
+
+	for(uint8_t i = 0; i < IMU_PERIOD_NUM; i++) {
+		if(imu_period[i] != 0) {
+			channels |= imu_period_channel_mask(i);
+		}
+	}
+
+	channels |= imu_buffer_channels;
+
+	if(imu_use_leds) {
+		channels |= (1 << IMU_CHANNEL_ACC) | (1 << IMU_CHANNEL_ORI);
+	}
+
+	// imu_channel_last_use is 0 until the first use, without the mask all
+	// channels would be active for IMU_CHANNEL_USE_TIMEOUT after the start
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if((imu_channel_use_mask & (1 << i)) &&
+		   (time - imu_channel_last_use[i] < IMU_CHANNEL_USE_TIMEOUT)) {
+			channels |= 1 << i;
+		}
+	}
+
+	return channels;
 }
 
-bool read_calibration_from_bno055_and_save_to_flash(void) {
-	if(sensor_data.calibration_status != 0xFF) {
-		return false;
+// Returns the active channels whose sample period has elapsed
+uint16_t imu_get_due_channels(const uint32_t time) {
+	const uint16_t active = imu_get_active_channels(time);
+	uint16_t channels = 0;
+
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if((active & (1 << i)) &&
+		   (time - imu_channel_last_read[i] >= imu_channel_sample_period[i])) {
+			channels |= 1 << i;
+		}
 	}
 
-	bmo_write_register(REG_OPR_MODE, 0b00000000); // Configuration Mode
-	SLEEP_MS(19);
-	IMUCalibration imu_calibration = {{0}};
-	bmo_read_registers(REG_ACC_OFFSET_X_LSB, (uint8_t *)&imu_calibration, IMU_CALIBRATION_LENGTH);
-	imu_calibration.password = IMU_CALIBRATION_PASSWORD;
-	bmo_write_register(REG_OPR_MODE, 0b00001100); // Enable NDOF, see Table 3-5
-	SLEEP_MS(7);
+	// The calibration status is watched without keeping the BNO055 awake,
+	// so it does not count as active channel for the idle state
+	if(imu_calibration_watch() &&
+	   (time - imu_channel_last_read[IMU_CHANNEL_CAL] >= IMU_CALIBRATION_WATCH_PERIOD)) {
+		channels |= 1 << IMU_CHANNEL_CAL;
+	}
 
-	logimui("Read calibration from BNO055 and save to flash:\n\r");
-	logimui(" Mag Offset: %d %d %d\n\r", imu_calibration.mag_offset[0], imu_calibration.mag_offset[1], imu_calibration.mag_offset[2]);
-	logimui(" Acc Offset: %d %d %d\n\r", imu_calibration.acc_offset[0], imu_calibration.acc_offset[1], imu_calibration.acc_offset[2]);
-	logimui(" Gyr Offset: %d %d %d\n\r", imu_calibration.gyr_offset[0], imu_calibration.gyr_offset[1], imu_calibration.gyr_offset[2]);
-	logimui(" Acc Radius: %d\n\r", imu_calibration.acc_radius);
-	logimui(" Mag Radius: %d\n\r", imu_calibration.mag_radius);
+	return channels;
+}
 
-	DISABLE_RESET_BUTTON();
-	__disable_irq();
+// Reading faster than the BNO055 updates its data registers only
+// produces duplicates. The output period is rounded up to whole ticks.
+uint16_t imu_get_min_acquisition_period(void) {
+	const uint32_t period = (imu_get_output_period() + 999)/1000;
+	return MAX(period, IMU_ACQUISITION_PERIOD_NON_FUSION);
+}
 
-	// Unlock flash region
-	if(FLASHD_Unlock(IMU_CALIBRATION_ADDRESS,
-	                 END_OF_BRICKLET_MEMORY,
-	                 NULL,
-	                 NULL) != 0) {
-		return false;
+// Returns the channels that the BNO055 provides in the given operation
+// mode, see Table 3-3
+uint16_t imu_get_valid_channels(const uint8_t mode) {
+	uint16_t channels = (1 << IMU_CHANNEL_TMP) | (1 << IMU_CHANNEL_CAL);
+
+	switch(mode) {
+		case IMU_OPERATION_MODE_ACCONLY:  channels |= (1 << IMU_CHANNEL_ACC); break;
+		case IMU_OPERATION_MODE_MAGONLY:  channels |= (1 << IMU_CHANNEL_MAG); break;
+		case IMU_OPERATION_MODE_GYROONLY: channels |= (1 << IMU_CHANNEL_ANG); break;
+		case IMU_OPERATION_MODE_ACCMAG:   channels |= (1 << IMU_CHANNEL_ACC) | (1 << IMU_CHANNEL_MAG); break;
+		case IMU_OPERATION_MODE_ACCGYRO:  channels |= (1 << IMU_CHANNEL_ACC) | (1 << IMU_CHANNEL_ANG); break;
+		case IMU_OPERATION_MODE_MAGGYRO:  channels |= (1 << IMU_CHANNEL_MAG) | (1 << IMU_CHANNEL_ANG); break;
+		case IMU_OPERATION_MODE_AMG:      channels |= (1 << IMU_CHANNEL_ACC) | (1 << IMU_CHANNEL_MAG) | (1 << IMU_CHANNEL_ANG); break;
+		case IMU_OPERATION_MODE_IMU:      channels |= IMU_CHANNEL_MASK_FUSION | (1 << IMU_CHANNEL_ACC) | (1 << IMU_CHANNEL_ANG); break;
+		case IMU_OPERATION_MODE_COMPASS:
+		case IMU_OPERATION_MODE_M4G:      channels |= IMU_CHANNEL_MASK_FUSION | (1 << IMU_CHANNEL_ACC) | (1 << IMU_CHANNEL_MAG); break;
+		case IMU_OPERATION_MODE_NDOF_FMC_OFF:
+		case IMU_OPERATION_MODE_NDOF:     channels |= IMU_CHANNEL_MASK_ALL; break;
 	}
 
-	if(FLASHD_Write(IMU_CALIBRATION_ADDRESS,
-	                &imu_calibration,
-	                sizeof(IMUCalibration)) != 0) {
-		return false;
+	return channels;
+}
+
+void imu_set_operation_mode(const uint8_t mode) {
+	imu_mode_take();
+	PIO_DisableIt(&pin_bno_int);
+
+	bmo_set_operation_mode(IMU_OPERATION_MODE_CONFIG);
+	imu_operation_mode = mode;
+	bmo_set_operation_mode(imu_operation_mode);
+
+	imu_acquisition_period = MAX(imu_acquisition_period, imu_get_min_acquisition_period());
+	imu_enable_int();
+
+	save_sensor_configuration_to_flash();
+	imu_mode_give();
+}
+
+uint16_t imu_period_channel_mask(const uint8_t type) {
+	if(type == IMU_PERIOD_TYPE_ALL) {
+		return IMU_CHANNEL_MASK_ALL;
 	}
 
-	if(FLASHD_Lock(IMU_CALIBRATION_ADDRESS,
-	               END_OF_BRICKLET_MEMORY,
-	               NULL,
-			       NULL) != 0) {
-		return false;
+	if(type == IMU_PERIOD_TYPE_CMP) {
+		return imu_compact_channels;
 	}
 
-	__enable_irq();
-    ENABLE_RESET_BUTTON();
+	if(type == IMU_PERIOD_TYPE_MSK) {
+		return imu_channel_data_channels;
+	}
 
-	return true;
+	return 1 << type;
 }
 
-bool read_calibration_from_flash_and_save_to_bno055(void) {
-	bool ret = false;
-	if(imu_calibration_in_flash->password == IMU_CALIBRATION_PASSWORD) {
-		logimui("Read calibration from flash and save to BNO055:\n\r");
-		logimui(" Mag Offset: %d %d %d\n\r", imu_calibration_in_flash->mag_offset[0], imu_calibration_in_flash->mag_offset[1], imu_calibration_in_flash->mag_offset[2]);
-		logimui(" Acc Offset: %d %d %d\n\r", imu_calibration_in_flash->acc_offset[0], imu_calibration_in_flash->acc_offset[1], imu_calibration_in_flash->acc_offset[2]);
-		logimui(" Gyr Offset: %d %d %d\n\r", imu_calibration_in_flash->gyr_offset[0], imu_calibration_in_flash->gyr_offset[1], imu_calibration_in_flash->gyr_offset[2]);
-		logimui(" Acc Radius: %d\n\r", imu_calibration_in_flash->acc_radius);
-		logimui(" Mag Radius: %d\n\r", imu_calibration_in_flash->mag_radius);
-		ret = true;
-		bmo_write_registers(REG_ACC_OFFSET_X_LSB, (uint8_t *)IMU_CALIBRATION_ADDRESS, IMU_CALIBRATION_LENGTH);
-	} else {
-		logimui("No calibration found\n\r");
+// Marks channels as used by a getter, they will be read for the next
+// IMU_CHANNEL_USE_TIMEOUT ms.
+void imu_channel_used(const uint16_t channels) {
+	const uint32_t time = xTaskGetTickCount()*portTICK_RATE_MS;
+	imu_channel_use_mask |= channels;
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if(channels & (1 << i)) {
+			imu_channel_last_use[i] = time;
+		}
 	}
+}
 
-	bmo_write_register(REG_OPR_MODE, 0b00001100); // Enable NDOF, see Table 3-5
-	SLEEP_MS(7);
+// Returns the channels that are not acquired periodically at the moment or
+// whose last read is older than they would be with periodic acquisition:
+// The sample period of the channel, at least two acquisition periods (the
+// interrupt acquisition falls back to twice the period).
+uint16_t imu_get_stale_channels(const uint16_t channels, const uint32_t time) {
+	const uint16_t active = imu_get_active_channels(time);
+	uint16_t stale = 0;
+
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if(!(channels & (1 << i))) {
+			continue;
+		}
 
-	return ret;
+		const uint32_t limit = MAX(imu_channel_sample_period[i], imu_acquisition_period*2);
+		if(!(active & (1 << i)) || (time - imu_channel_last_read[i] > limit)) {
+			stale |= 1 << i;
+		}
+	}
+
+	return stale;
 }
 
-void imu_startblink(void) {
-	imu_leds_on(true);
-	Pin pins[] = {PINS_IMU_LED};
-	for(uint8_t i = 0; i < 6; i++) {
-		pins[i].type = PIO_OUTPUT_1;
+// Returns the sensor data for a getter. Channels that were not acquired
+// recently are requested from the tick task and the getter waits until
+// they are read, so the first call after a pause does not return old data.
+// The reply is always a sample of the double buffer, the sequence number
+// identifies its data.
+//
+// If the BNO055 is idle, the tick task wakes it up because the channels
+// are used now. Its data registers keep the values from before the idle
+// phase, so we wait until the tick task read new data. After
+// IMU_FRESH_DATA_TIMEOUT ms the newest sample is returned as it is, its
+// timestamp shows how old it is.
+void imu_get_fresh_sensor_data(const uint16_t channels, SensorData *data, SampleInfo *info) {
+	const uint32_t time = xTaskGetTickCount()*portTICK_RATE_MS;
+	const uint16_t stale = imu_get_stale_channels(channels, time) &
+	                       imu_get_valid_channels(imu_operation_mode);
+
+	imu_channel_used(channels);
+	if(stale != 0) {
+		taskENTER_CRITICAL();
+		imu_channel_requested |= stale;
+		taskEXIT_CRITICAL();
+
+		while(((imu_channel_requested & stale) != 0) || imu_idle || imu_wake_pending) {
+			if(xTaskGetTickCount()*portTICK_RATE_MS - time >= IMU_FRESH_DATA_TIMEOUT) {
+				break;
+			}
+
+			SLEEP_MS(1);
+		}
 	}
 
-	PIO_Configure(pins, PIO_LISTSIZE(pins));
+	imu_get_sensor_data(data, info);
+}
 
-	for(uint8_t i = 0; i < 41; i++) {
-		TC0->TC_CHANNEL[0].TC_RA = blink_lookup[i];
-		TC0->TC_CHANNEL[1].TC_RA = blink_lookup[i];
-		TC0->TC_CHANNEL[2].TC_RB = blink_lookup[i];
-		PWMC_SetDutyCycle(PWM, 3, blink_lookup[40-i]);
-		SLEEP_MS(6);
+// Makes a list of register windows that cover the given channels. Windows
+// of channels that are adjacent in the register map are merged into one
+// TWI transfer. The data registers have no holes, so two channels that are
+// not adjacent are separated by at least one whole channel (6 byte), which
+// costs more bus time than the address and register bytes of a new
+// transfer, these are not merged.
+uint8_t imu_plan_reads(const uint16_t channels, IMUReadWindow *windows) {
+	uint8_t num = 0;
+
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		const uint8_t channel = imu_channel_register_order[i];
+		if(!(channels & (1 << channel))) {
+			continue;
+		}
+
+		const IMUReadWindow *window = &imu_channel_window[channel];
+		if(num > 0) {
+			IMUReadWindow *last = &windows[num-1];
+			const uint8_t last_end = last->offset + last->length;
+			if(window->offset == last_end) {
+				last->length = window->offset + window->length - last->offset;
+				continue;
+			}
+		}
+
+		windows[num] = *window;
+		num++;
 	}
-	for(uint8_t i = 0; i < 41; i++) {
-		TC0->TC_CHANNEL[0].TC_RA = blink_lookup[40-i];
-		TC0->TC_CHANNEL[1].TC_RA = blink_lookup[40-i];
-		TC0->TC_CHANNEL[2].TC_RB = blink_lookup[40-i];
-		PWMC_SetDutyCycle(PWM, 3, blink_lookup[i]);
-		SLEEP_MS(6);
 
+	return num;
+}
+
+// Returns a consistent copy of the newest sensor data without locking.
+// The writer only ever writes the back buffer, so if the sequence did not
+// change while copying, the copied buffer was not touched in the meantime.
+void imu_get_sensor_data(SensorData *data, SampleInfo *info) {
+	uint32_t sequence;
+	uint32_t timestamp;
+	do {
+		sequence = sensor_data_sequence;
+		__DMB();
+		memcpy(data, &sensor_data_buffer[sequence & 1], sizeof(SensorData));
+		timestamp = sensor_data_timestamp[sequence & 1];
+		__DMB();
+	} while(sequence != sensor_data_sequence);
+
+	if(info != NULL) {
+		info->timestamp = timestamp;
+		info->sequence  = sequence;
 	}
-	for(uint8_t i = 0; i < 41; i++) {
-		TC0->TC_CHANNEL[0].TC_RA = blink_lookup[i];
-		TC0->TC_CHANNEL[1].TC_RA = blink_lookup[i];
-		TC0->TC_CHANNEL[2].TC_RB = blink_lookup[i];
-		PWMC_SetDutyCycle(PWM, 3, blink_lookup[40-i]);
-		SLEEP_MS(6);
+}
+
+// Returns a free running µs counter (wraps after ~71 minutes). The µs
+// within the current ms are taken from the SysTick counter, which counts
+// down from LOAD once per FreeRTOS tick. If SysTick wrapped but the tick
+// interrupt did not run yet, the tick count is one behind.
+uint32_t imu_get_timestamp(void) {
+	taskENTER_CRITICAL();
+	uint32_t ticks = xTaskGetTickCount();
+	uint32_t value = SysTick->VAL;
+	if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+		value = SysTick->VAL;
+		ticks++;
 	}
+	taskEXIT_CRITICAL();
 
-	imu_leds_on(false);
+	return ticks*portTICK_RATE_MS*1000 + (SysTick->LOAD - value)/(BOARD_MCK/1000000);
 }
 
-void imu_init(void) {
-	logimui("IMU init start\n\r");
-	Pin pins_bno[] = {PINS_BNO};
-	PIO_Configure(pins_bno, PIO_LISTSIZE(pins_bno));
+// Same as imu_get_timestamp, for use in interrupt handlers
+uint32_t imu_get_timestamp_from_isr(void) {
+	const unsigned portBASE_TYPE mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	uint32_t ticks = xTaskGetTickCountFromISR();
+	uint32_t value = SysTick->VAL;
+	if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+		value = SysTick->VAL;
+		ticks++;
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+	return ticks*portTICK_RATE_MS*1000 + (SysTick->LOAD - value)/(BOARD_MCK/1000000);
+}
+
+// Copies the values of one channel (IMU_CHANNEL_*) in the same order
+// as in the corresponding getter and returns the number of values
+uint8_t imu_get_channel_values(const SensorData *data, const uint8_t channel, int16_t *values) {
+	switch(channel) {
+		case IMU_CHANNEL_ACC: {
+			values[0] = data->acc_x;
+			values[1] = data->acc_y;
+			values[2] = data->acc_z;
+			return 3;
+		}
+
+		case IMU_CHANNEL_MAG: {
+			values[0] = data->mag_x;
+			values[1] = data->mag_y;
+			values[2] = data->mag_z;
+			return 3;
+		}
+
+		case IMU_CHANNEL_ANG: {
+			values[0] = data->gyr_x;
+			values[1] = data->gyr_y;
+			values[2] = data->gyr_z;
+			return 3;
+		}
+
+		case IMU_CHANNEL_TMP: {
+			values[0] = data->temperature;
+			return 1;
+		}
+
+		case IMU_CHANNEL_ORI: {
+			values[0] = data->eul_heading;
+			values[1] = data->eul_roll;
+			values[2] = data->eul_pitch;
+			return 3;
+		}
+
+		case IMU_CHANNEL_LIA: {
+			values[0] = data->lia_x;
+			values[1] = data->lia_y;
+			values[2] = data->lia_z;
+			return 3;
+		}
+
+		case IMU_CHANNEL_GRV: {
+			values[0] = data->grv_x;
+			values[1] = data->grv_y;
+			values[2] = data->grv_z;
+			return 3;
+		}
+
+		case IMU_CHANNEL_QUA: {
+			values[0] = data->qua_w;
+			values[1] = data->qua_x;
+			values[2] = data->qua_y;
+			values[3] = data->qua_z;
+			return 4;
+		}
+
+		case IMU_CHANNEL_CAL: {
+			values[0] = data->calibration_status;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Copies the values of all given channels in channel order and returns
+// the number of values. values needs room for IMU_CHANNEL_VALUES_MAX.
+uint8_t imu_pack_channels(const SensorData *data, const uint16_t channels, int16_t *values) {
+	uint8_t num = 0;
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if(channels & (1 << i)) {
+			num += imu_get_channel_values(data, i, &values[num]);
+		}
+	}
+
+	return num;
+}
+
+void imu_threshold_configure(const uint8_t type, const uint8_t mode, const uint16_t threshold, const uint32_t keepalive) {
+	IMUThreshold *t = &imu_threshold[type];
+
+	t->mode      = mode;
+	t->threshold = threshold;
+	t->keepalive = keepalive;
+	t->force     = true;
+
+	if(mode == IMU_THRESHOLD_MODE_QUATERNION) {
+		// Quaternion values are scaled by 2^14, a product of two by 2^28
+		const float angle = threshold*M_PI/18000.0f;
+		t->quaternion_limit = cosf(angle/2.0f)*(1 << 28);
+	}
+}
+
+// Called with every due period callback. Returns true if the callback
+// has to be sent: The threshold is turned off, the value changed enough
+// since the last sent callback, or the keepalive period elapsed.
+bool imu_threshold_check(const uint8_t type, const SensorData *data) {
+	if(type >= IMU_THRESHOLD_NUM || imu_threshold[type].mode == IMU_THRESHOLD_MODE_OFF) {
+		return true;
+	}
+
+	IMUThreshold *t = &imu_threshold[type];
+	const uint32_t time = xTaskGetTickCount()*portTICK_RATE_MS;
+
+	int16_t values[4] = {0, 0, 0, 0};
+	const uint8_t num = imu_get_channel_values(data, type, values);
+
+	bool send = t->force || ((t->keepalive != 0) && (time - t->last_time >= t->keepalive));
+	if(!send) {
+		switch(t->mode) {
+			case IMU_THRESHOLD_MODE_AXIS: {
+				for(uint8_t i = 0; i < num; i++) {
+					if(ABS(values[i] - t->last_values[i]) > t->threshold) {
+						send = true;
+						break;
+					}
+				}
+				break;
+			}
+
+			case IMU_THRESHOLD_MODE_MAGNITUDE: {
+				uint64_t sum = 0;
+				for(uint8_t i = 0; i < num; i++) {
+					const int32_t diff = values[i] - t->last_values[i];
+					sum += (int64_t)diff*diff;
+				}
+				send = sum > (uint64_t)t->threshold*t->threshold;
+				break;
+			}
+
+			case IMU_THRESHOLD_MODE_QUATERNION: {
+				// The rotation between q and p is 2*acos(|q·p|)
+				int32_t dot = 0;
+				for(uint8_t i = 0; i < num; i++) {
+					dot += values[i]*t->last_values[i];
+				}
+				send = ABS(dot) < t->quaternion_limit;
+				break;
+			}
+		}
+	}
+
+	if(send) {
+		memcpy(t->last_values, values, sizeof(values));
+		t->last_time = time;
+		t->force = false;
+	}
+
+	return send;
+}
+
+void imu_compact_configure(const uint16_t channels, const uint8_t keyframe_interval) {
+	imu_compact_channels = channels;
+	imu_compact_keyframe_interval = keyframe_interval;
+
+	// Start the new configuration with a keyframe
+	imu_compact_since_keyframe = keyframe_interval;
+}
+
+// Zigzag maps small negative and positive deltas to small unsigned
+// numbers, which are then written with 7 bit per byte (LEB128)
+static uint8_t imu_compact_write_delta(const int32_t delta, uint8_t *data) {
+	uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+	uint8_t length = 0;
+
+	while(value >= 0x80) {
+		data[length++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	data[length++] = value;
+
+	return length;
+}
+
+// A keyframe contains the channel mask and all values as int16 (little
+// endian). Other frames only contain the varint coded deltas to the
+// previous frame. If the receiver sees a gap in the sequence number it has
+// to wait for the next keyframe. The packet length is variable.
+void make_compact_stream_callback(const SensorData *data, const SampleInfo *info) {
+	int16_t values[IMU_CHANNEL_VALUES_MAX];
+	const uint8_t num = imu_pack_channels(data, imu_compact_channels, values);
+	const uint8_t keyframe_length = sizeof(uint16_t) + num*sizeof(int16_t);
+
+	CompactStreamCallback csc;
+	uint8_t length = 0;
+	bool keyframe = imu_compact_since_keyframe >= imu_compact_keyframe_interval;
+
+	if(!keyframe) {
+		uint8_t deltas[IMU_CHANNEL_VALUES_MAX*IMU_COMPACT_VARINT_MAX];
+		for(uint8_t i = 0; i < num; i++) {
+			length += imu_compact_write_delta(values[i] - imu_compact_last_values[i], &deltas[length]);
+		}
+
+		// Deltas of fast changing values can be bigger than the values
+		// themselves, in this case a keyframe is cheaper
+		if(length >= keyframe_length) {
+			keyframe = true;
+		} else {
+			memcpy(csc.data, deltas, length);
+			imu_compact_since_keyframe++;
+		}
+	}
+
+	if(keyframe) {
+		csc.data[0] = imu_compact_channels & 0xFF;
+		csc.data[1] = imu_compact_channels >> 8;
+		memcpy(&csc.data[2], values, num*sizeof(int16_t));
+		length = keyframe_length;
+		imu_compact_since_keyframe = 1;
+	}
+
+	memcpy(imu_compact_last_values, values, num*sizeof(int16_t));
+
+	const uint8_t size = sizeof(CompactStreamCallback) - IMU_COMPACT_DATA_SIZE + length;
+	com_make_default_header(&csc, com_info.uid, size, FID_COMPACT_STREAM);
+	csc.sequence = imu_compact_sequence++;
+	csc.flags    = keyframe ? IMU_COMPACT_FLAG_KEYFRAME : 0;
+
+	imu_send_callback(&csc, size, info, IMU_PERIOD_TYPE_CMP);
+}
+
+static void imu_perf_clear(void) {
+	for(uint8_t i = 0; i < IMU_PERF_STAGE_NUM; i++) {
+		imu_perf[i].count    = 0;
+		imu_perf[i].min      = UINT32_MAX;
+		imu_perf[i].max      = 0;
+		imu_perf[i].sum      = 0;
+		imu_perf[i].overruns = 0;
+	}
+}
+
+// The DWT cycle counter runs with the core clock (wraps after 67s at
+// 64MHz), reading it costs a single load
+void imu_perf_init(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	imu_perf_clear();
+}
+
+void imu_perf_reset(void) {
+	taskENTER_CRITICAL();
+	imu_perf_clear();
+	taskEXIT_CRITICAL();
+}
+
+void imu_perf_get(const uint8_t stage, IMUPerfStatistics *perf) {
+	taskENTER_CRITICAL();
+	*perf = imu_perf[stage];
+	taskEXIT_CRITICAL();
+}
+
+// Called from the tick task and from the getters in the message task
+// (TWI reads, sends), the update has to be atomic
+void imu_perf_record(const uint8_t stage, const uint32_t cycles) {
+	IMUPerfStatistics *perf = &imu_perf[stage];
+
+	taskENTER_CRITICAL();
+	perf->count++;
+	perf->sum += cycles;
+	perf->min = MIN(perf->min, cycles);
+	perf->max = MAX(perf->max, cycles);
+	// Only a whole tick has the budget of one tick, the other stages are
+	// parts of a tick or run in the message task
+	if(((stage == IMU_PERF_STAGE_TICK_CALCULATION) || (stage == IMU_PERF_STAGE_TICK_MESSAGE)) &&
+	   (cycles > IMU_PERF_TICK_CYCLES)) {
+		perf->overruns++;
+	}
+	taskEXIT_CRITICAL();
+}
+
+void imu_send_message(const void *data, const uint8_t length, const ComType com) {
+	const uint32_t start = DWT->CYCCNT;
+	send_blocking_with_timeout(data, length, com);
+
+	const uint32_t cycles = DWT->CYCCNT - start;
+	imu_perf_send_cycles += cycles;
+	imu_perf_record(IMU_PERF_STAGE_SEND, cycles);
+}
+
+// Copies the message and appends the sample info if it is enabled and
+// the message has room for it. Returns the new length of the message.
+uint8_t imu_add_sample_info(uint8_t *message, const void *data, const uint8_t length, const SampleInfo *info) {
+	memcpy(message, data, length);
+
+	if(!imu_sample_info || (info == NULL) || (length + sizeof(SampleInfo) > IMU_MESSAGE_SIZE_MAX)) {
+		return length;
+	}
+
+	memcpy(&message[length], info, sizeof(SampleInfo));
+	((MessageHeader*)message)->length = length + sizeof(SampleInfo);
+
+	return length + sizeof(SampleInfo);
+}
+
+void imu_send_sample(const void *data, const uint8_t length, const ComType com, const SampleInfo *info) {
+	uint8_t message[IMU_MESSAGE_SIZE_MAX];
+	const uint8_t message_length = imu_add_sample_info(message, data, length, info);
+
+	imu_send_message(message, message_length, com);
+}
+
+// With coalescing enabled the callbacks of one tick are collected and
+// sent as one CALLBACK_FRAME message, which contains the complete
+// callback messages back to back in their original order. Callbacks that
+// don't fit in a frame are sent on their own after flushing the frame.
+void imu_send_callback(const void *data, const uint8_t length, const SampleInfo *info, const uint8_t type) {
+	uint8_t message[IMU_MESSAGE_SIZE_MAX];
+	const uint8_t message_length = imu_add_sample_info(message, data, length, info);
+
+	if(!imu_callback_coalescing || message_length > IMU_CALLBACK_FRAME_SIZE) {
+		imu_flush_callbacks();
+		imu_send_message(message, message_length, com_info.current);
+		if(info != NULL) {
+			imu_latency_record(type, info->timestamp);
+		}
+		return;
+	}
+
+	if((imu_callback_frame_length + message_length > IMU_CALLBACK_FRAME_SIZE) ||
+	   (imu_callback_frame_count == IMU_CALLBACK_FRAME_MESSAGES_MAX)) {
+		imu_flush_callbacks();
+	}
+
+	memcpy(&imu_callback_frame[imu_callback_frame_length], message, message_length);
+	imu_callback_frame_length += message_length;
+	imu_callback_frame_type[imu_callback_frame_count] = info == NULL ? IMU_LATENCY_TYPE_NONE : type;
+	imu_callback_frame_timestamp[imu_callback_frame_count] = info == NULL ? 0 : info->timestamp;
+	imu_callback_frame_count++;
+}
+
+void imu_flush_callbacks(void) {
+	if(imu_callback_frame_count == 0) {
+		return;
+	}
+
+	// A single callback is sent as is, a frame would only add a header
+	if(imu_callback_frame_count == 1) {
+		imu_send_message(imu_callback_frame, imu_callback_frame_length, com_info.current);
+	} else {
+		CallbackFrameCallback cfc;
+		const uint8_t size = sizeof(MessageHeader) + imu_callback_frame_length;
+		com_make_default_header(&cfc, com_info.uid, size, FID_CALLBACK_FRAME);
+		memcpy(cfc.messages, imu_callback_frame, imu_callback_frame_length);
+
+		imu_send_message(&cfc, size, com_info.current);
+	}
+
+	for(uint8_t i = 0; i < imu_callback_frame_count; i++) {
+		imu_latency_record(imu_callback_frame_type[i], imu_callback_frame_timestamp[i]);
+	}
+
+	imu_callback_frame_length = 0;
+	imu_callback_frame_count = 0;
+}
+
+// Sorts the time from the completed read of a sample to the completed
+// send of its callback into a histogram per callback type
+void imu_latency_record(const uint8_t type, const uint32_t timestamp) {
+	if(type >= IMU_PERIOD_NUM) {
+		return;
+	}
+
+	const uint32_t latency = imu_get_timestamp() - timestamp;
+	uint8_t bucket = 0;
+	while((bucket < IMU_LATENCY_BUCKET_NUM - 1) && (latency >= imu_latency_bucket_limit[bucket])) {
+		bucket++;
+	}
+
+	if(imu_latency_histogram[type][bucket] < UINT32_MAX) {
+		imu_latency_histogram[type][bucket]++;
+	}
+}
+
+void imu_latency_reset(void) {
+	taskENTER_CRITICAL();
+	memset(imu_latency_histogram, 0, sizeof(imu_latency_histogram));
+	taskEXIT_CRITICAL();
+}
+
+void imu_latency_get(const uint8_t type, uint32_t *histogram) {
+	taskENTER_CRITICAL();
+	memcpy(histogram, imu_latency_histogram[type], sizeof(imu_latency_histogram[type]));
+	taskEXIT_CRITICAL();
+}
+
+// Sends the values of the selected channels packed in channel order, the
+// packet length depends on the selected channels
+void make_channel_data_callback(const SensorData *data, const SampleInfo *info) {
+	int16_t values[IMU_CHANNEL_VALUES_MAX];
+	const uint8_t num = imu_pack_channels(data, imu_channel_data_channels, values);
+
+	ChannelDataCallback cdc;
+	const uint8_t size = sizeof(ChannelDataCallback) - sizeof(cdc.values) + num*sizeof(int16_t);
+	com_make_default_header(&cdc, com_info.uid, size, FID_CHANNEL_DATA);
+	cdc.channel_mask = imu_channel_data_channels;
+	memcpy(cdc.values, values, num*sizeof(int16_t));
+
+	imu_send_callback(&cdc, size, info, IMU_PERIOD_TYPE_MSK);
+}
+
+// Size of a buffered sample with the given channels: The timestamp and the
+// packed values
+uint8_t imu_buffer_get_sample_size(const uint16_t channels) {
+	uint8_t size = sizeof(uint32_t);
+	for(uint8_t i = 0; i < IMU_CHANNEL_NUM; i++) {
+		if(channels & (1 << i)) {
+			size += imu_channel_value_num[i]*sizeof(int16_t);
+		}
+	}
+
+	return size;
+}
+
+uint8_t imu_buffer_get_samples_per_message(const uint16_t channels) {
+	return IMU_BUFFER_MESSAGE_DATA_SIZE/imu_buffer_get_sample_size(channels);
+}
+
+// All samples in the buffer have the same channels, a new channel mask
+// clears the buffer
+void imu_buffer_configure(const uint16_t channels, const uint8_t watermark) {
+	taskENTER_CRITICAL();
+	if(channels != imu_buffer_channels) {
+		imu_buffer_start = 0;
+		imu_buffer_count = 0;
+		imu_buffer_samples_lost = 0;
+		imu_buffer_sample_size = imu_buffer_get_sample_size(channels);
+		imu_buffer_capacity = IMU_BUFFER_SIZE/imu_buffer_sample_size;
+	}
+	imu_buffer_channels = channels;
+	imu_buffer_watermark = watermark;
+	taskEXIT_CRITICAL();
+}
+
+void imu_buffer_push(const SensorData *data, const uint32_t timestamp) {
+	int16_t values[IMU_CHANNEL_VALUES_MAX];
+
+	taskENTER_CRITICAL();
+	// Packed with the lock held, the message task may change the channels
+	const uint8_t num = imu_pack_channels(data, imu_buffer_channels, values);
+
+	// If the buffer is full we overwrite the oldest sample
+	if(imu_buffer_count == imu_buffer_capacity) {
+		imu_buffer_start = (imu_buffer_start + 1) % imu_buffer_capacity;
+		imu_buffer_count--;
+		if(imu_buffer_samples_lost < UINT16_MAX) {
+			imu_buffer_samples_lost++;
+		}
+	}
+
+	uint8_t *sample = &imu_buffer[((imu_buffer_start + imu_buffer_count) % imu_buffer_capacity)*imu_buffer_sample_size];
+	memcpy(sample, &timestamp, sizeof(uint32_t));
+	memcpy(sample + sizeof(uint32_t), values, num*sizeof(int16_t));
+	imu_buffer_count++;
+	taskEXIT_CRITICAL();
+}
+
+// Removes up to count samples from the buffer, copies them back to back
+// to data and returns the number of samples removed. samples_lost is the
+// number of samples that were overwritten since the last pop.
+uint8_t imu_buffer_pop(uint8_t *data, const uint8_t count, uint16_t *samples_lost) {
+	taskENTER_CRITICAL();
+	const uint8_t num = MIN(count, imu_buffer_count);
+	for(uint8_t i = 0; i < num; i++) {
+		memcpy(&data[i*imu_buffer_sample_size], &imu_buffer[imu_buffer_start*imu_buffer_sample_size], imu_buffer_sample_size);
+		imu_buffer_start = (imu_buffer_start + 1) % imu_buffer_capacity;
+	}
+	imu_buffer_count -= num;
+
+	*samples_lost = imu_buffer_samples_lost;
+	imu_buffer_samples_lost = 0;
+	taskEXIT_CRITICAL();
+
+	return num;
+}
+
+void imu_buffer_callback(void) {
+	if((imu_buffer_watermark == 0) || (imu_buffer_count < imu_buffer_watermark)) {
+		return;
+	}
+
+	BufferedSamplesCallback bsc;
+	uint16_t samples_lost;
+	com_make_default_header(&bsc, com_info.uid, sizeof(BufferedSamplesCallback), FID_BUFFERED_SAMPLES);
+	memset(bsc.data, 0, sizeof(bsc.data));
+	bsc.channel_mask = imu_buffer_channels;
+	bsc.sample_count = imu_buffer_pop(bsc.data, imu_buffer_get_samples_per_message(imu_buffer_channels), &samples_lost);
+	bsc.samples_lost = samples_lost;
+
+	imu_send_callback(&bsc, sizeof(BufferedSamplesCallback), NULL, IMU_LATENCY_TYPE_NONE);
+}
+
+void imu_int_handler(const Pin *pin) {
+	(void)pin;
+
+	// The interrupt status is read in the tick task, we can't use the TWI
+	// in an interrupt handler. The INT line stays high until it is reset,
+	// so the edge time is the time of the first event.
+	if(imu_motion_configuration.interrupts != 0) {
+		if(!imu_int_status_pending) {
+			imu_int_timestamp = imu_get_timestamp_from_isr();
+		}
+		imu_int_status_pending = true;
+	}
+
+	if(imu_acquisition_mode == IMU_ACQUISITION_MODE_INTERRUPT) {
+		imu_data_ready = true;
+	}
+}
+
+// Reads which interrupts fired, update_sensor_data resets the INT line
+// afterwards. The timestamp of an event is the time of the INT edge, taken
+// in imu_int_handler.
+void imu_read_interrupt_status(void) {
+	uint8_t status = 0;
+	if(!bmo_read_registers_async(REG_INT_STA, &status, 1)) {
+		return;
+	}
+
+	status &= imu_motion_configuration.interrupts;
+	if(status != 0) {
+		if(imu_motion_events == 0) {
+			imu_motion_timestamp = imu_int_timestamp;
+		}
+		imu_motion_events |= status;
+		imu_wake();
+	}
+}
+
+void imu_motion_callback(void) {
+	if(imu_motion_events == 0) {
+		return;
+	}
+
+	MotionEventCallback mec;
+	com_make_default_header(&mec, com_info.uid, sizeof(MotionEventCallback), FID_MOTION_EVENT);
+	mec.events    = imu_motion_events;
+	mec.timestamp = imu_motion_timestamp;
+
+	imu_motion_events = 0;
+
+	imu_send_callback(&mec, sizeof(MotionEventCallback), NULL, IMU_LATENCY_TYPE_NONE);
+}
+
+// Puts the BNO055 in the idle power mode if nobody used any data for
+// imu_idle_timeout ms. The next getter, enabled callback or motion event
+// wakes it up again.
+void imu_update_idle_state(const uint32_t time) {
+	if(imu_get_active_channels(time) != 0) {
+		imu_last_activity = time;
+		if(imu_idle) {
+			imu_wake();
+		}
+		return;
+	}
+
+	// Idle with recent activity: A wake up was requested while another
+	// power switch ran or it timed out, try again
+	if(imu_idle && (time - imu_last_activity < imu_idle_timeout)) {
+		imu_wake();
+		return;
+	}
+
+	if(imu_idle_enable && !imu_idle && (time - imu_last_activity >= imu_idle_timeout)) {
+		imu_power_switch_request(imu_idle_power_mode);
+	}
+}
+
+// Called from both tasks. If a power switch is already running the wake up
+// is requested again by imu_update_idle_state once it is done.
+void imu_wake(void) {
+	imu_last_activity = xTaskGetTickCount()*portTICK_RATE_MS;
+	if(imu_idle && imu_power_switch_request(IMU_POWER_MODE_NORMAL)) {
+		imu_wake_start = imu_get_timestamp();
+	}
+}
+
+// Requested by both tasks, check and set have to be atomic
+bool imu_power_switch_request(const uint8_t power_mode) {
+	taskENTER_CRITICAL();
+	const bool idle = imu_power_switch_state == IMU_POWER_SWITCH_IDLE;
+	if(idle) {
+		imu_power_switch_mode = power_mode;
+		imu_power_switch_request_time = xTaskGetTickCount()*portTICK_RATE_MS;
+		imu_power_switch_state = IMU_POWER_SWITCH_START;
+	}
+	taskEXIT_CRITICAL();
+
+	return idle;
+}
+
+// The power mode can only be changed in config mode. Like the calibration
+// save, the switch comes back in later ticks instead of sleeping for the
+// mode switch times in the tick task. It owns the mode from start to
+// finish, update_sensor_data does not read meanwhile.
+void imu_power_switch_tick(void) {
+	const uint32_t time = xTaskGetTickCount()*portTICK_RATE_MS;
+
+	switch(imu_power_switch_state) {
+		case IMU_POWER_SWITCH_IDLE: {
+			return;
+		}
+
+		case IMU_POWER_SWITCH_START: {
+			if(!imu_mode_try_take()) {
+				if(time - imu_power_switch_request_time >= IMU_POWER_SWITCH_TIMEOUT) {
+					logimuw("Power mode switch to %d timed out\n\r", imu_power_switch_mode);
+					imu_power_switch_state = IMU_POWER_SWITCH_IDLE;
+				}
+				return;
+			}
+
+			imu_samples_continuous = false;
+			bmo_write_register(REG_OPR_MODE, IMU_OPERATION_MODE_CONFIG);
+			imu_power_switch_time = time;
+			imu_power_switch_state = IMU_POWER_SWITCH_CONFIG_MODE;
+			break;
+		}
+
+		// See imu_calibration_save_tick for the wait conditions
+		case IMU_POWER_SWITCH_CONFIG_MODE: {
+			if(time - imu_power_switch_time <= IMU_MODE_SWITCH_TIME_CONFIG) {
+				return;
+			}
+
+			bmo_write_register(REG_PWR_MODE, imu_power_switch_mode);
+			bmo_write_register(REG_OPR_MODE, imu_operation_mode);
+			imu_power_switch_time = time;
+			imu_power_switch_state = IMU_POWER_SWITCH_OPERATION_MODE;
+			break;
+		}
+
+		case IMU_POWER_SWITCH_OPERATION_MODE: {
+			if(time - imu_power_switch_time <= IMU_MODE_SWITCH_TIME_OPERATION) {
+				return;
+			}
+
+			imu_power_switch_finish();
+			break;
+		}
+	}
+}
+
+void imu_power_switch_finish(void) {
+	// The mode switch may have dropped an INT edge
+	if(imu_int_used()) {
+		imu_reset_int();
+	}
+
+	if(imu_power_switch_mode == IMU_POWER_MODE_NORMAL) {
+		imu_idle = false;
+		imu_wake_pending = true;
+		imu_wake_count++;
+		update_sensor_counter = UINT16_MAX; // Read as soon as possible
+		logimui("Leave idle power mode\n\r");
+	} else {
+		imu_idle = true;
+		imu_wake_pending = false;
+		logimui("Enter idle power mode %d\n\r", imu_power_switch_mode);
+	}
+
+	imu_power_switch_state = IMU_POWER_SWITCH_IDLE;
+	imu_mode_give();
+}
+
+// Operation mode, power mode, interrupt and sensor configuration changes
+// switch the BNO055 to config mode and back. They must not run while the
+// calibration save has it in config mode or writes the flash, and not
+// interleaved with each other. Whoever switches the mode has to own it.
+bool imu_mode_try_take(void) {
+	taskENTER_CRITICAL();
+	const bool free = !imu_mode_busy;
+	imu_mode_busy = true;
+	taskEXIT_CRITICAL();
+
+	return free;
+}
+
+// Waits until the mode is free, e.g. until a running calibration save is
+// done. Only for the message task, the tick task has to use
+// imu_mode_try_take since it runs the calibration save itself.
+void imu_mode_take(void) {
+	while(!imu_mode_try_take()) {
+		SLEEP_MS(1);
+	}
+}
+
+void imu_mode_give(void) {
+	imu_mode_busy = false;
+}
+
+void imu_set_acquisition_mode(const uint8_t mode) {
+	imu_acquisition_mode = mode;
+	imu_configure_interrupts();
+}
+
+void imu_set_motion_configuration(const IMUMotionConfiguration *config) {
+	imu_motion_configuration = *config;
+	imu_motion_events = 0;
+	imu_configure_interrupts();
+}
+
+bool imu_int_used(void) {
+	return (imu_acquisition_mode == IMU_ACQUISITION_MODE_INTERRUPT) ||
+	       (imu_motion_configuration.interrupts != 0);
+}
+
+void imu_reset_int(void) {
+	bmo_write_register(REG_SYS_TRIGGER, SYS_TRIGGER_CLK_SEL | SYS_TRIGGER_RST_INT);
+}
+
+// Ends a reconfiguration that ran with the PIO interrupt disabled. An
+// interrupt from before may have latched the INT line and its edge is
+// dropped here, without a reset the line would never rise again.
+void imu_enable_int(void) {
+	imu_data_ready = false;
+	if(imu_int_used()) {
+		imu_reset_int();
+		PIO_EnableIt(&pin_bno_int);
+	}
+}
+
+// The INT line is shared by the data ready interrupt of the interrupt
+// acquisition mode and the motion interrupts
+void imu_configure_interrupts(void) {
+	const IMUMotionConfiguration *config = &imu_motion_configuration;
+	uint8_t int_mask = config->interrupts;
+	if(imu_acquisition_mode == IMU_ACQUISITION_MODE_INTERRUPT) {
+		int_mask |= INT_ACC_BSX_DRDY;
+	}
+
+	imu_mode_take();
+	PIO_DisableIt(&pin_bno_int);
+
+	bmo_set_operation_mode(IMU_OPERATION_MODE_CONFIG);
+
+	// Interrupt configuration is on page 1
+	bmo_write_register(REG_PAGE_ID, 1);
+	bmo_write_register(REG_ACC_AM_THRES, config->any_motion_threshold);
+	bmo_write_register(REG_ACC_INT_SETTINGS, (config->any_motion_duration & 0x03) |
+	                                         ACC_INT_SETTINGS_AM_NM_XYZ |
+	                                         ACC_INT_SETTINGS_HG_XYZ);
+	bmo_write_register(REG_ACC_HG_DURATION, config->high_g_duration);
+	bmo_write_register(REG_ACC_HG_THRES, config->high_g_threshold);
+	bmo_write_register(REG_ACC_NM_THRES, config->no_motion_threshold);
+	bmo_write_register(REG_ACC_NM_SET, (config->no_motion_duration & 0x3F) << ACC_NM_SET_DURATION_POS);
+	bmo_write_register(REG_GYR_INT_SETTINGS, GYR_INT_SETTINGS_AM_XYZ);
+	bmo_write_register(REG_GYR_AM_THRES, config->gyroscope_any_motion_threshold & 0x7F);
+	bmo_write_register(REG_INT_MSK, int_mask);
+	bmo_write_register(REG_INT_EN, int_mask);
+	bmo_write_register(REG_PAGE_ID, 0);
+
+	bmo_set_operation_mode(imu_operation_mode);
+
+	imu_int_status_pending = false;
+	imu_enable_int();
+	imu_mode_give();
+}
+
+void bmo_set_operation_mode(const uint8_t mode) {
+	// The gap of the mode switch is not a missed sample
+	imu_samples_continuous = false;
+	bmo_write_register(REG_OPR_MODE, mode);
+
+	// SLEEP_MS(x) returns with the x-th tick interrupt, which can be up to
+	// one ms less than x ms after the write
+	if(mode == IMU_OPERATION_MODE_CONFIG) {
+		SLEEP_MS(IMU_MODE_SWITCH_TIME_CONFIG + 1);
+	} else {
+		SLEEP_MS(IMU_MODE_SWITCH_TIME_OPERATION + 1);
+	}
+}
+
+void bmo_write_register(const uint8_t reg, uint8_t const value) {
+	mutex_take(mutex_twi_bricklet, MUTEX_BLOCKING);
+    TWID_Write(&twid,
+    		   BMO055_ADDRESS_HIGH,
+    		   reg,
+               1,
+               (uint8_t *)&value,
+               1,
+               NULL);
+	mutex_give(mutex_twi_bricklet);
+}
+
+void bmo_write_registers(const uint8_t reg, const uint8_t *data, const uint8_t length) {
+	mutex_take(mutex_twi_bricklet, MUTEX_BLOCKING);
+    TWID_Write(&twid,
+    		   BMO055_ADDRESS_HIGH,
+    		   reg,
+               1,
+               (uint8_t *)data,
+               length,
+               NULL);
+	mutex_give(mutex_twi_bricklet);
+}
+
+void bmo_read_registers(const uint8_t reg, uint8_t *data, const uint8_t length) {
+	mutex_take(mutex_twi_bricklet, MUTEX_BLOCKING);
+    TWID_Read(&twid,
+    		   BMO055_ADDRESS_HIGH,
+    		   reg,
+               1,
+               data,
+               length,
+               NULL);
+	mutex_give(mutex_twi_bricklet);
+}
+
+// Stops a transfer that TWID would never finish. Without the STOP
+// condition the BNO055 could keep SDA low.
+void bmo_abort_transfer(void) {
+	TWI_DisableIt(twid.pTwi, TWI_IDR_RXRDY | TWI_IDR_TXRDY | TWI_IDR_TXCOMP);
+	TWI_Stop(twid.pTwi);
+	twid.pTransfer = NULL;
+}
+
+bool bmo_read_registers_async(const uint8_t reg, uint8_t *data, const uint8_t length) {
+	const uint32_t wait_start = DWT->CYCCNT;
+	mutex_take(mutex_twi_bricklet, MUTEX_BLOCKING);
+
+	const uint32_t read_start = DWT->CYCCNT;
+	imu_perf_record(IMU_PERF_STAGE_MUTEX_WAIT, read_start - wait_start);
+
+	memset(&imu_async, 0, sizeof(Async));
+	if(TWID_Read(&twid,
+	             BMO055_ADDRESS_HIGH,
+	             reg,
+	             1,
+	             data,
+	             length,
+	             &imu_async) != 0) {
+		mutex_give(mutex_twi_bricklet);
+		return false;
+	}
+
+	// The transfer is driven by the TWI interrupt, we give the CPU to the
+	// message loop until it is done instead of busy waiting for each byte.
+	// TWID only finishes a transfer on TXCOMP, after a NACK or with a stuck
+	// bus it never does. The transfer is aborted after its deadline, so
+	// that neither the tick task nor the bricklets on the bus hang. The
+	// caller keeps the previous data then.
+	const uint32_t deadline = imu_get_timestamp() + BMO055_TWI_TIMEOUT(length);
+	bool ok = true;
+	while(!ASYNC_IsFinished(&imu_async)) {
+		if((int32_t)(imu_get_timestamp() - deadline) > 0) {
+			bmo_abort_transfer();
+			ok = false;
+			break;
+		}
+
+		taskYIELD();
+	}
+
+	if(imu_async.status != 0) {
+		ok = false;
+	}
+
+	mutex_give(mutex_twi_bricklet);
+	imu_perf_record(IMU_PERF_STAGE_TWI_READ, DWT->CYCCNT - read_start);
+
+	return ok;
+}
+
+void TWI0_IrqHandler(void) {
+	TWID_Handler(&twid);
+}
+
+// Starts saving the calibration in the background, see
+// imu_calibration_save_tick. Returns false if the BNO055 is not fully
+// calibrated or a save is already running.
+bool imu_calibration_save_start(void) {
+	if(imu_calibration_save_state != IMU_CALIBRATION_SAVE_IDLE) {
+		return false;
+	}
+
+	// The calibration status may not be acquired periodically, read it here
+	uint8_t calibration_status = 0;
+	bmo_read_registers(REG_CALIB_START, &calibration_status, 1);
+	if(calibration_status != 0xFF) {
+		return false;
+	}
+
+	return imu_calibration_save_request(false);
+}
+
+// A save is requested by the message task (save_calibration) and by the
+// tick task (automatic save), all other state changes are done by the
+// tick task. Check and set have to be atomic.
+bool imu_calibration_save_request(const bool automatic) {
+	taskENTER_CRITICAL();
+	const bool idle = imu_calibration_save_state == IMU_CALIBRATION_SAVE_IDLE;
+	if(idle) {
+		imu_calibration_save_automatic = automatic;
+		imu_calibration_save_state = IMU_CALIBRATION_SAVE_START;
+	}
+	taskEXIT_CRITICAL();
+
+	return idle;
+}
+
+// Saving the calibration takes several ticks: The offsets can only be read
+// in config mode and the mode switches take 19ms and 7ms. Instead of
+// sleeping we come back in a later tick. The flash can't be read while
+// it is written, so the interrupts have to be disabled while a flash
+// command runs. Unlock, write and lock are done in separate ticks to keep
+// these phases short. The save owns the mode from start to finish, it
+// waits in the start state until a running mode change is done.
+void imu_calibration_save_tick(void) {
+	const uint32_t time = xTaskGetTickCount()*portTICK_RATE_MS;
+
+	switch(imu_calibration_save_state) {
+		case IMU_CALIBRATION_SAVE_IDLE: {
+			return;
+		}
+
+		case IMU_CALIBRATION_SAVE_START: {
+			if(!imu_mode_try_take()) {
+				return;
+			}
+
+			imu_samples_continuous = false;
+			bmo_write_register(REG_OPR_MODE, IMU_OPERATION_MODE_CONFIG);
+			imu_calibration_save_time = time;
+			imu_calibration_save_state = IMU_CALIBRATION_SAVE_CONFIG_MODE;
+			break;
+		}
+
+		// The mode was written during the tick of imu_calibration_save_time,
+		// so the switch time is only over one tick later than the difference
+		case IMU_CALIBRATION_SAVE_CONFIG_MODE: {
+			if(time - imu_calibration_save_time <= IMU_MODE_SWITCH_TIME_CONFIG) {
+				return;
+			}
+
+			IMUCalibration *calibration = &imu_calibration_save_data;
+			memset(calibration, 0, sizeof(IMUCalibration));
+			bmo_read_registers(REG_ACC_OFFSET_X_LSB, (uint8_t *)calibration, IMU_CALIBRATION_LENGTH);
+			calibration->password = IMU_CALIBRATION_PASSWORD;
+			bmo_write_register(REG_OPR_MODE, imu_operation_mode);
+
+			// An automatic save does not wear the flash if the calibration
+			// did not change
+			imu_calibration_save_skip = imu_calibration_save_automatic && !imu_calibration_differs(calibration);
+			if(imu_calibration_save_skip) {
+				logimui("Calibration unchanged, automatic save skipped\n\r");
+				imu_calibration_save_time = time;
+				imu_calibration_save_state = IMU_CALIBRATION_SAVE_OPERATION_MODE;
+				break;
+			}
+
+			logimui("Read calibration from BNO055 and save to flash:\n\r");
+			logimui(" Mag Offset: %d %d %d\n\r", calibration->mag_offset[0], calibration->mag_offset[1], calibration->mag_offset[2]);
+			logimui(" Acc Offset: %d %d %d\n\r", calibration->acc_offset[0], calibration->acc_offset[1], calibration->acc_offset[2]);
+			logimui(" Gyr Offset: %d %d %d\n\r", calibration->gyr_offset[0], calibration->gyr_offset[1], calibration->gyr_offset[2]);
+			logimui(" Acc Radius: %d\n\r", calibration->acc_radius);
+			logimui(" Mag Radius: %d\n\r", calibration->mag_radius);
+
+			imu_calibration_save_time = time;
+			imu_calibration_save_state = IMU_CALIBRATION_SAVE_OPERATION_MODE;
+			break;
+		}
+
+		case IMU_CALIBRATION_SAVE_OPERATION_MODE: {
+			if(time - imu_calibration_save_time <= IMU_MODE_SWITCH_TIME_OPERATION) {
+				return;
+			}
+
+			if(imu_calibration_save_skip) {
+				imu_calibration_save_automatic = false;
+				imu_calibration_save_state = IMU_CALIBRATION_SAVE_IDLE;
+				imu_mode_give();
+				break;
+			}
+
+			imu_calibration_save_state = IMU_CALIBRATION_SAVE_UNLOCK;
+			break;
+		}
+
+		case IMU_CALIBRATION_SAVE_UNLOCK: {
+			DISABLE_RESET_BUTTON();
+			__disable_irq();
+			const bool ok = FLASHD_Unlock(IMU_CALIBRATION_ADDRESS, END_OF_BRICKLET_MEMORY, NULL, NULL) == 0;
+			__enable_irq();
+
+			if(!ok) {
+				ENABLE_RESET_BUTTON();
+				imu_calibration_save_finish(false);
+				break;
+			}
+
+			imu_calibration_save_state = IMU_CALIBRATION_SAVE_WRITE;
+			break;
+		}
+
+		case IMU_CALIBRATION_SAVE_WRITE: {
+			__disable_irq();
+			imu_calibration_save_success = imu_calibration_log_write(&imu_calibration_save_data);
+			__enable_irq();
+
+			// Lock again even if the write failed
+			imu_calibration_save_state = IMU_CALIBRATION_SAVE_LOCK;
+			break;
+		}
+
+		case IMU_CALIBRATION_SAVE_LOCK: {
+			__disable_irq();
+			const bool ok = FLASHD_Lock(IMU_CALIBRATION_ADDRESS, END_OF_BRICKLET_MEMORY, NULL, NULL) == 0;
+			__enable_irq();
+			ENABLE_RESET_BUTTON();
+
+			imu_calibration_save_finish(imu_calibration_save_success && ok);
+			break;
+		}
+	}
+}
+
+void imu_calibration_save_finish(const bool success) {
+	imu_calibration_save_automatic = false;
+	imu_calibration_save_success = success;
+	imu_calibration_save_done = true;
+	imu_calibration_save_state = IMU_CALIBRATION_SAVE_IDLE;
+	imu_mode_give();
+}
+
+// While the BNO055 is in config mode for the calibration save its data
+// registers are not updated
+bool imu_calibration_save_in_config_mode(void) {
+	return (imu_calibration_save_state >= IMU_CALIBRATION_SAVE_CONFIG_MODE) &&
+	       (imu_calibration_save_state <= IMU_CALIBRATION_SAVE_OPERATION_MODE);
+}
+
+void imu_calibration_saved_callback(void) {
+	if(!imu_calibration_save_done) {
+		return;
+	}
+
+	CalibrationSavedCallback csc;
+	com_make_default_header(&csc, com_info.uid, sizeof(CalibrationSavedCallback), FID_CALIBRATION_SAVED);
+	csc.success = imu_calibration_save_success;
+
+	imu_calibration_save_done = false;
+
+	imu_send_callback(&csc, sizeof(CalibrationSavedCallback), NULL, IMU_LATENCY_TYPE_NONE);
+}
+
+// Returns true if the calibration differs meaningfully from the stored
+// one (or if there is none)
+bool imu_calibration_differs(const IMUCalibration *calibration) {
+	const IMUCalibration *stored = imu_calibration_find();
+	if(stored == NULL) {
+		return true;
+	}
+
+	for(uint8_t i = 0; i < 3; i++) {
+		if((ABS(calibration->acc_offset[i] - stored->acc_offset[i]) > IMU_CALIBRATION_DIFF_ACC) ||
+		   (ABS(calibration->mag_offset[i] - stored->mag_offset[i]) > IMU_CALIBRATION_DIFF_MAG) ||
+		   (ABS(calibration->gyr_offset[i] - stored->gyr_offset[i]) > IMU_CALIBRATION_DIFF_GYR)) {
+			return true;
+		}
+	}
+
+	return (ABS(calibration->acc_radius - stored->acc_radius) > IMU_CALIBRATION_DIFF_RADIUS) ||
+	       (ABS(calibration->mag_radius - stored->mag_radius) > IMU_CALIBRATION_DIFF_RADIUS);
+}
+
+bool imu_calibration_watch(void) {
+	return imu_calibration_auto_save || imu_calibration_status_callback_enable;
+}
+
+// Called from the acquisition with every new calibration status. The
+// automatic save is only started when full calibration is reached, not
+// while it is kept.
+void imu_calibration_update_status(const uint8_t calibration_status, const uint32_t time) {
+	if(calibration_status == imu_calibration_status) {
+		return;
+	}
+
+	imu_calibration_status = calibration_status;
+	if(imu_calibration_status_callback_enable) {
+		imu_calibration_status_changed = true;
+	}
+
+	if(imu_calibration_auto_save &&
+	   (calibration_status == 0xFF) &&
+	   (!imu_calibration_auto_save_done || (time - imu_calibration_auto_save_time >= IMU_CALIBRATION_AUTO_SAVE_INTERVAL)) &&
+	   imu_calibration_save_request(true)) {
+		imu_calibration_auto_save_done = true;
+		imu_calibration_auto_save_time = time;
+	}
+}
+
+void imu_calibration_status_changed_callback(void) {
+	if(!imu_calibration_status_changed) {
+		return;
+	}
+
+	CalibrationStatusChangedCallback cscc;
+	com_make_default_header(&cscc, com_info.uid, sizeof(CalibrationStatusChangedCallback), FID_CALIBRATION_STATUS_CHANGED);
+	cscc.calibration_status = imu_calibration_status;
+
+	imu_calibration_status_changed = false;
+
+	imu_send_callback(&cscc, sizeof(CalibrationStatusChangedCallback), NULL, IMU_LATENCY_TYPE_NONE);
+}
+
+bool imu_flash_write(const uint32_t address, const void *data, const uint32_t length) {
+	bool ret = false;
+
+	DISABLE_RESET_BUTTON();
+	__disable_irq();
+
+	// Unlock flash region
+	if(FLASHD_Unlock(IMU_CALIBRATION_ADDRESS,
+	                 END_OF_BRICKLET_MEMORY,
+	                 NULL,
+	                 NULL) == 0) {
+		ret = FLASHD_Write(address, data, length) == 0;
+
+		if(FLASHD_Lock(IMU_CALIBRATION_ADDRESS,
+		               END_OF_BRICKLET_MEMORY,
+		               NULL,
+		               NULL) != 0) {
+			ret = false;
+		}
+	}
+
+	__enable_irq();
+	ENABLE_RESET_BUTTON();
+
+	return ret;
+}
+
+bool read_calibration_from_flash_and_save_to_bno055(void) {
+	bool ret = false;
+	const IMUCalibration *calibration = imu_calibration_find();
+	if(calibration != NULL) {
+		logimui("Read calibration from flash (slot %d) and save to BNO055:\n\r", imu_calibration_slot);
+		logimui(" Mag Offset: %d %d %d\n\r", calibration->mag_offset[0], calibration->mag_offset[1], calibration->mag_offset[2]);
+		logimui(" Acc Offset: %d %d %d\n\r", calibration->acc_offset[0], calibration->acc_offset[1], calibration->acc_offset[2]);
+		logimui(" Gyr Offset: %d %d %d\n\r", calibration->gyr_offset[0], calibration->gyr_offset[1], calibration->gyr_offset[2]);
+		logimui(" Acc Radius: %d\n\r", calibration->acc_radius);
+		logimui(" Mag Radius: %d\n\r", calibration->mag_radius);
+		ret = true;
+		bmo_write_registers(REG_ACC_OFFSET_X_LSB, (const uint8_t *)calibration, IMU_CALIBRATION_LENGTH);
+	} else {
+		logimui("No calibration found\n\r");
+	}
+
+	bmo_set_operation_mode(imu_operation_mode);
+
+	return ret;
+}
+
+bool imu_calibration_record_valid(const IMUCalibrationRecord *record) {
+	return (record->calibration.password == IMU_CALIBRATION_PASSWORD) &&
+	       (record->crc == crc16((const uint8_t *)record, offsetof(IMUCalibrationRecord, crc)));
+}
+
+// Returns the newest valid calibration in flash or NULL. Records with a
+// broken CRC (e.g. an interrupted write) are skipped. Calibrations saved
+// by older firmwares (a single IMUCalibration at IMU_CALIBRATION_ADDRESS,
+// without CRC) are used if there is no record.
+const IMUCalibration *imu_calibration_find(void) {
+	const IMUCalibrationRecord *records = (const IMUCalibrationRecord *)IMU_CALIBRATION_ADDRESS;
+
+	imu_calibration_slot = IMU_CALIBRATION_SLOT_NONE;
+	imu_calibration_sequence = 0;
+	for(uint8_t i = 0; i < IMU_CALIBRATION_SLOTS; i++) {
+		if(imu_calibration_record_valid(&records[i]) &&
+		   ((imu_calibration_slot == IMU_CALIBRATION_SLOT_NONE) ||
+		    (records[i].sequence > imu_calibration_sequence))) {
+			imu_calibration_slot = i;
+			imu_calibration_sequence = records[i].sequence;
+		}
+	}
+
+	if(imu_calibration_slot != IMU_CALIBRATION_SLOT_NONE) {
+		return &records[imu_calibration_slot].calibration;
+	}
+
+	if(records[0].calibration.password == IMU_CALIBRATION_PASSWORD) {
+		return &records[0].calibration;
+	}
+
+	return NULL;
+}
+
+// Appends a record to the calibration log. The flash has to be unlocked
+// and the interrupts disabled. The page is only erased if the record is
+// the first one in the page, or if the slot is not blank (e.g. after an
+// interrupted write). Otherwise the page is written without erase: A write
+// only clears bits, so the latch buffer is 0xFF except for the new record
+// and the other records are not programmed again. An erase in the middle
+// of the page has to write the older records of the page again.
+bool imu_calibration_log_write(const IMUCalibration *calibration) {
+	const uint8_t slot = imu_calibration_slot == IMU_CALIBRATION_SLOT_NONE ? 0 : (imu_calibration_slot + 1) % IMU_CALIBRATION_SLOTS;
+	const uint32_t address = IMU_CALIBRATION_ADDRESS + slot*IMU_CALIBRATION_RECORD_SIZE;
+	const uint32_t page_address = address - (address - IFLASH_ADDR) % IFLASH_PAGE_SIZE;
+
+	IMUCalibrationRecord record;
+	record.calibration = *calibration;
+	record.sequence    = imu_calibration_sequence + 1;
+	record.crc         = crc16((const uint8_t *)&record, offsetof(IMUCalibrationRecord, crc));
+
+	const bool first = (slot % IMU_CALIBRATION_SLOTS_PER_PAGE) == 0;
+	bool erase = first;
+	for(uint8_t i = 0; !first && (i < IMU_CALIBRATION_RECORD_SIZE); i++) {
+		if(((const uint8_t *)address)[i] != 0xFF) {
+			erase = true;
+			break;
+		}
+	}
+
+	uint32_t *page = imu_calibration_page;
+	if(erase && !first) {
+		memcpy(page, (const void *)page_address, IFLASH_PAGE_SIZE);
+	} else {
+		memset(page, 0xFF, IFLASH_PAGE_SIZE);
+	}
+	memcpy(((uint8_t *)page) + (address - page_address), &record, sizeof(IMUCalibrationRecord));
+
+	volatile uint32_t *latch = (volatile uint32_t *)page_address;
+	for(uint8_t i = 0; i < IFLASH_PAGE_SIZE/sizeof(uint32_t); i++) {
+		latch[i] = page[i];
+	}
+
+	const uint16_t page_number = (page_address - IFLASH_ADDR)/IFLASH_PAGE_SIZE;
+	if(EFC_PerformCommand(EFC, erase ? EFC_FCMD_EWP : EFC_FCMD_WP, page_number, 1) != 0) {
+		return false;
+	}
+
+	if(!imu_calibration_record_valid((const IMUCalibrationRecord *)address)) {
+		return false;
+	}
+
+	imu_calibration_slot = slot;
+	imu_calibration_sequence = record.sequence;
+
+	return true;
+}
+
+// Writes the sensor configuration to the page 1 registers. The BNO055 has
+// to be in config mode. In the fusion modes the fusion library overrides
+// most of the sensor configuration, see Table 3-7.
+void write_sensor_configuration_to_bno055(void) {
+	const IMUSensorConfiguration *config = &imu_sensor_configuration;
+
+	bmo_write_register(REG_PAGE_ID, 1);
+	bmo_write_register(REG_ACC_CONFIG, (config->accelerometer_range     << ACC_CONFIG_RANGE_POS) |
+	                                   (config->accelerometer_bandwidth << ACC_CONFIG_BANDWIDTH_POS));
+	bmo_write_register(REG_GYR_CONFIG_0, (config->gyroscope_range     << GYR_CONFIG_0_RANGE_POS) |
+	                                     (config->gyroscope_bandwidth << GYR_CONFIG_0_BANDWIDTH_POS));
+	bmo_write_register(REG_MAG_CONFIG, (config->magnetometer_rate << MAG_CONFIG_DATA_RATE_POS) |
+	                                   MAG_CONFIG_OPR_MODE_REGULAR);
+	bmo_write_register(REG_PAGE_ID, 0);
+}
+
+void imu_set_sensor_configuration(const IMUSensorConfiguration *config) {
+	imu_mode_take();
+	PIO_DisableIt(&pin_bno_int);
+
+	imu_sensor_configuration.accelerometer_range     = config->accelerometer_range;
+	imu_sensor_configuration.accelerometer_bandwidth = config->accelerometer_bandwidth;
+	imu_sensor_configuration.gyroscope_range         = config->gyroscope_range;
+	imu_sensor_configuration.gyroscope_bandwidth     = config->gyroscope_bandwidth;
+	imu_sensor_configuration.magnetometer_rate       = config->magnetometer_rate;
+
+	bmo_set_operation_mode(IMU_OPERATION_MODE_CONFIG);
+	write_sensor_configuration_to_bno055();
+	bmo_set_operation_mode(imu_operation_mode);
+
+	// The output data rate depends on the bandwidths in the non-fusion modes
+	imu_acquisition_period = MAX(imu_acquisition_period, imu_get_min_acquisition_period());
+	imu_enable_int();
+
+	save_sensor_configuration_to_flash();
+	imu_mode_give();
+}
+
+// Saves sensor configuration and operation mode, the flash is only
+// written if something changed
+bool save_sensor_configuration_to_flash(void) {
+	imu_sensor_configuration.operation_mode = imu_operation_mode;
+	imu_sensor_configuration.password       = IMU_SENSOR_CONFIGURATION_PASSWORD;
+
+	if(memcmp(&imu_sensor_configuration,
+	          (const void*)IMU_SENSOR_CONFIGURATION_ADDRESS,
+	          sizeof(IMUSensorConfiguration)) == 0) {
+		return true;
+	}
+
+	logimui("Save sensor configuration to flash\n\r");
+	return imu_flash_write(IMU_SENSOR_CONFIGURATION_ADDRESS,
+	                       &imu_sensor_configuration,
+	                       sizeof(IMUSensorConfiguration));
+}
+
+void read_sensor_configuration_from_flash(void) {
+	const IMUSensorConfiguration *config_in_flash = (const IMUSensorConfiguration*)IMU_SENSOR_CONFIGURATION_ADDRESS;
+	if(config_in_flash->password != IMU_SENSOR_CONFIGURATION_PASSWORD) {
+		logimui("No sensor configuration found\n\r");
+		return;
+	}
+
+	imu_sensor_configuration = *config_in_flash;
+	imu_operation_mode = imu_sensor_configuration.operation_mode;
+	imu_acquisition_period = MAX(imu_acquisition_period, imu_get_min_acquisition_period());
+	logimui("Read sensor configuration from flash: %d %d %d %d %d (mode %d)\n\r",
+	        imu_sensor_configuration.accelerometer_range,
+	        imu_sensor_configuration.accelerometer_bandwidth,
+	        imu_sensor_configuration.gyroscope_range,
+	        imu_sensor_configuration.gyroscope_bandwidth,
+	        imu_sensor_configuration.magnetometer_rate,
+	        imu_operation_mode);
+}
+
+void imu_startblink(void) {
+	imu_leds_on(true);
+	Pin pins[] = {PINS_IMU_LED};
+	for(uint8_t i = 0; i < 6; i++) {
+		pins[i].type = PIO_OUTPUT_1;
+	}
+
+	PIO_Configure(pins, PIO_LISTSIZE(pins));
+
+	for(uint8_t i = 0; i < 41; i++) {
+		TC0->TC_CHANNEL[0].TC_RA = blink_lookup[i];
+		TC0->TC_CHANNEL[1].TC_RA = blink_lookup[i];
+		TC0->TC_CHANNEL[2].TC_RB = blink_lookup[i];
+		PWMC_SetDutyCycle(PWM, 3, blink_lookup[40-i]);
+		SLEEP_MS(6);
+	}
+	for(uint8_t i = 0; i < 41; i++) {
+		TC0->TC_CHANNEL[0].TC_RA = blink_lookup[40-i];
+		TC0->TC_CHANNEL[1].TC_RA = blink_lookup[40-i];
+		TC0->TC_CHANNEL[2].TC_RB = blink_lookup[40-i];
+		PWMC_SetDutyCycle(PWM, 3, blink_lookup[i]);
+		SLEEP_MS(6);
+
+	}
+	for(uint8_t i = 0; i < 41; i++) {
+		TC0->TC_CHANNEL[0].TC_RA = blink_lookup[i];
+		TC0->TC_CHANNEL[1].TC_RA = blink_lookup[i];
+		TC0->TC_CHANNEL[2].TC_RB = blink_lookup[i];
+		PWMC_SetDutyCycle(PWM, 3, blink_lookup[40-i]);
+		SLEEP_MS(6);
+	}
+
+	imu_leds_on(false);
+}
+
+void imu_init(void) {
+	logimui("IMU init start\n\r");
+	Pin pins_bno[] = {PINS_BNO};
+	PIO_Configure(pins_bno, PIO_LISTSIZE(pins_bno));
+
+	// BNO055 INT is active high and latched until RST_INT in SYS_TRIGGER
+	pin_bno_int.attribute = PIO_IT_RISE_EDGE;
+	PIO_Configure(&pin_bno_int, 1);
+	PIO_ConfigureIt(&pin_bno_int, imu_int_handler);
+
+	imu_perf_init();
+
+	// Asynchronous TWI transfers are driven by the TWI interrupt
+	NVIC_SetPriority(TWI0_IRQn, PRIORITY_IMU_TWI0);
+	NVIC_EnableIRQ(TWI0_IRQn);
 
 	imu_startblink();
 
-	bmo_write_register(REG_OPR_MODE, 0b00000000); // Configuration Mode
-	SLEEP_MS(19);
+	bmo_set_operation_mode(IMU_OPERATION_MODE_CONFIG);
 
-	bmo_write_register(REG_SYS_TRIGGER, 1 << 7); // Use external clock
+	bmo_write_register(REG_SYS_TRIGGER, SYS_TRIGGER_CLK_SEL); // Use external clock
+	read_sensor_configuration_from_flash();
+	write_sensor_configuration_to_bno055();
 	read_calibration_from_flash_and_save_to_bno055();
 
 #ifndef PROFILING
@@ -36,8 +36,141 @@
 #define IMU_PERIOD_TYPE_GRV  6
 #define IMU_PERIOD_TYPE_QUA  7
 #define IMU_PERIOD_TYPE_ALL  8
+#define IMU_PERIOD_TYPE_CMP  9
+#define IMU_PERIOD_TYPE_MSK  10
 
-#define IMU_PERIOD_NUM       9
+#define IMU_PERIOD_NUM       11
+
+// Channels are the groups of values that are read from the BNO055. The
+// first eight are numbered like the corresponding period types.
+#define IMU_CHANNEL_ACC      0
+#define IMU_CHANNEL_MAG      1
+#define IMU_CHANNEL_ANG      2
+#define IMU_CHANNEL_TMP      3
+#define IMU_CHANNEL_ORI      4
+#define IMU_CHANNEL_LIA      5
+#define IMU_CHANNEL_GRV      6
+#define IMU_CHANNEL_QUA      7
+#define IMU_CHANNEL_CAL      8
+
+#define IMU_CHANNEL_NUM      9
+#define IMU_CHANNEL_MASK_ALL ((1 << IMU_CHANNEL_NUM) - 1)
+#define IMU_CHANNEL_MASK_FUSION ((1 << IMU_CHANNEL_ORI) | (1 << IMU_CHANNEL_LIA) | \
+                                 (1 << IMU_CHANNEL_GRV) | (1 << IMU_CHANNEL_QUA))
+
+// All channels packed with imu_pack_channels: six channels with three
+// values (acc, mag, gyr, euler, linear acceleration, gravity), the
+// quaternion and the single values of temperature and calibration status
+#define IMU_CHANNEL_VALUES_MAX (6*3 + 4 + 1 + 1)
+
+#define IMU_CHANNEL_USE_TIMEOUT 2000 // in ms, a getter keeps a channel active this long
+
+#define IMU_ACQUISITION_MODE_POLL      0
+#define IMU_ACQUISITION_MODE_INTERRUPT 1
+
+#define IMU_ACQUISITION_PERIOD_DEFAULT    10    // in ms
+#define IMU_ACQUISITION_PERIOD_MAX        10000 // in ms
+#define IMU_ACQUISITION_PERIOD_FUSION     10    // in ms, fusion output rate is 100Hz
+#define IMU_ACQUISITION_PERIOD_NON_FUSION 1     // in ms, one tick
+
+// The callback period limit is 0 (off) or between the acquisition period
+// and IMU_CALLBACK_PERIOD_MIN_MAX
+#define IMU_CALLBACK_PERIOD_MIN_MAX       IMU_ACQUISITION_PERIOD_MAX // in ms
+
+// Operation modes, see Table 3-5
+#define IMU_OPERATION_MODE_CONFIG       0
+#define IMU_OPERATION_MODE_ACCONLY      1
+#define IMU_OPERATION_MODE_MAGONLY      2
+#define IMU_OPERATION_MODE_GYROONLY     3
+#define IMU_OPERATION_MODE_ACCMAG       4
+#define IMU_OPERATION_MODE_ACCGYRO      5
+#define IMU_OPERATION_MODE_MAGGYRO      6
+#define IMU_OPERATION_MODE_AMG          7
+#define IMU_OPERATION_MODE_IMU          8
+#define IMU_OPERATION_MODE_COMPASS      9
+#define IMU_OPERATION_MODE_M4G          10
+#define IMU_OPERATION_MODE_NDOF_FMC_OFF 11
+#define IMU_OPERATION_MODE_NDOF         12
+
+// See Table 3-6: Switching from any mode to config mode takes 19ms,
+// from config mode to any operation mode 7ms
+#define IMU_MODE_SWITCH_TIME_CONFIG     19
+#define IMU_MODE_SWITCH_TIME_OPERATION  7
+
+#define IMU_CALIBRATION_SAVE_IDLE           0
+#define IMU_CALIBRATION_SAVE_START          1
+#define IMU_CALIBRATION_SAVE_CONFIG_MODE    2
+#define IMU_CALIBRATION_SAVE_OPERATION_MODE 3
+#define IMU_CALIBRATION_SAVE_UNLOCK         4
+#define IMU_CALIBRATION_SAVE_WRITE          5
+#define IMU_CALIBRATION_SAVE_LOCK           6
+
+#define IMU_POWER_SWITCH_IDLE           0
+#define IMU_POWER_SWITCH_START          1
+#define IMU_POWER_SWITCH_CONFIG_MODE    2
+#define IMU_POWER_SWITCH_OPERATION_MODE 3
+
+// A power mode switch that can't take the mode within this time (e.g.
+// because a calibration save runs) is dropped. The idle state update
+// requests it again if it is still needed.
+#define IMU_POWER_SWITCH_TIMEOUT        100 // in ms
+
+// With automatic calibration save or the calibration status changed
+// callback enabled the calibration status is read at least every
+// IMU_CALIBRATION_WATCH_PERIOD ms. When it reaches full calibration the
+// offsets are saved automatically, if one of them differs from the stored
+// calibration by more than the given number of LSB and the last automatic
+// save is at least IMU_CALIBRATION_AUTO_SAVE_INTERVAL ms ago.
+#define IMU_CALIBRATION_WATCH_PERIOD        100
+#define IMU_CALIBRATION_AUTO_SAVE_INTERVAL  60000
+#define IMU_CALIBRATION_DIFF_ACC            10 // 1m/s^2 = 100 LSB
+#define IMU_CALIBRATION_DIFF_MAG            16 // 1uT = 16 LSB
+#define IMU_CALIBRATION_DIFF_GYR            16 // 1dps = 16 LSB
+#define IMU_CALIBRATION_DIFF_RADIUS         10
+
+// See 3.2 (Power management)
+#define IMU_POWER_MODE_NORMAL           0
+#define IMU_POWER_MODE_LOW_POWER        1
+#define IMU_POWER_MODE_SUSPEND          2
+
+#define IMU_IDLE_TIMEOUT_DEFAULT        10000 // in ms
+#define IMU_FRESH_DATA_TIMEOUT          100   // in ms, a getter waits this long for stale channels or a wake up
+
+#define IMU_COMPACT_DATA_SIZE       62
+#define IMU_COMPACT_FLAG_KEYFRAME   (1 << 0)
+#define IMU_COMPACT_KEYFRAME_INTERVAL_DEFAULT 50
+#define IMU_COMPACT_VARINT_MAX      3 // a 17 bit zigzag delta needs at most 3 varint bytes
+
+#define IMU_THRESHOLD_NUM           8 // period types ACC to QUA
+#define IMU_THRESHOLD_MODE_OFF        0 // callback with every period
+#define IMU_THRESHOLD_MODE_AXIS       1 // one value changed by more than threshold
+#define IMU_THRESHOLD_MODE_MAGNITUDE  2 // length of the change vector above threshold
+#define IMU_THRESHOLD_MODE_QUATERNION 3 // rotation above threshold (in 1/100°)
+#define IMU_THRESHOLD_QUATERNION_MAX  18000
+
+#define IMU_PERF_STAGE_TWI_READ         0 // async TWI read, including the time given to other tasks
+#define IMU_PERF_STAGE_MUTEX_WAIT       1 // waiting for mutex_twi_bricklet
+#define IMU_PERF_STAGE_PACKET_BUILD     2 // make_period_callback without sending
+#define IMU_PERF_STAGE_SEND             3 // send_blocking_with_timeout
+#define IMU_PERF_STAGE_TICK_CALCULATION 4
+#define IMU_PERF_STAGE_TICK_MESSAGE     5
+#define IMU_PERF_STAGE_NUM              6
+#define IMU_PERF_TICK_CYCLES            (BOARD_MCK/1000) // a tick that takes longer is an overrun
+
+#define IMU_LATENCY_BUCKET_NUM      8    // <1, <2, <5, <10, <20, <50, <100 and >=100ms
+#define IMU_LATENCY_TYPE_NONE       0xFF // callbacks without sample latency
+
+#define IMU_CALLBACK_FRAME_SIZE     64 // payload of one message
+#define IMU_CALLBACK_FRAME_MESSAGES_MAX 8
+#define IMU_MESSAGE_SIZE_MAX        72 // header and payload
+
+#define IMU_BLINK_PERIOD     10 // in ms
+
+// A buffered sample is the timestamp followed by the values of the buffered
+// channels packed with imu_pack_channels. The buffer holds 29 samples of
+// all channels or 153 samples of one channel with three values.
+#define IMU_BUFFER_SIZE                1536 // in byte
+#define IMU_BUFFER_MESSAGE_DATA_SIZE   59   // in byte, see BufferedSamplesCallback
 
 #define RANGE_ACCELEROMETER_2G  0
 #define RANGE_ACCELEROMETER_4G  1
@@ -50,11 +183,45 @@
 #define RANGE_GYROSCOPE_250DPS  3
 #define RANGE_GYROSCOPE_125DPS  4
 
+#define BANDWIDTH_ACCELEROMETER_7_81HZ 0
+#define BANDWIDTH_ACCELEROMETER_15_63HZ 1
+#define BANDWIDTH_ACCELEROMETER_31_25HZ 2
+#define BANDWIDTH_ACCELEROMETER_62_5HZ 3
+#define BANDWIDTH_ACCELEROMETER_125HZ 4
+#define BANDWIDTH_ACCELEROMETER_250HZ 5
+#define BANDWIDTH_ACCELEROMETER_500HZ 6
+#define BANDWIDTH_ACCELEROMETER_1000HZ 7
+
+#define BANDWIDTH_GYROSCOPE_523HZ 0
+#define BANDWIDTH_GYROSCOPE_230HZ 1
+#define BANDWIDTH_GYROSCOPE_116HZ 2
+#define BANDWIDTH_GYROSCOPE_47HZ  3
+#define BANDWIDTH_GYROSCOPE_23HZ  4
+#define BANDWIDTH_GYROSCOPE_12HZ  5
+#define BANDWIDTH_GYROSCOPE_64HZ  6
+#define BANDWIDTH_GYROSCOPE_32HZ  7
+
+#define DATA_RATE_MAGNETOMETER_2HZ  0
+#define DATA_RATE_MAGNETOMETER_6HZ  1
+#define DATA_RATE_MAGNETOMETER_8HZ  2
+#define DATA_RATE_MAGNETOMETER_10HZ 3
+#define DATA_RATE_MAGNETOMETER_15HZ 4
+#define DATA_RATE_MAGNETOMETER_20HZ 5
+#define DATA_RATE_MAGNETOMETER_25HZ 6
+#define DATA_RATE_MAGNETOMETER_30HZ 7
+
 #define IMU_STARTUP_TIME     650 // see 1.2 (POR time)
 
 #define BMO055_ADDRESS_HIGH  0x29
 #define BMO055_ADDRESS_LOW   0x28
 
+// An async read that takes twice as long as it should is aborted. A read
+// is start, address and register byte, repeated start and address, then
+// the data, 9 clocks per byte including the (N)ACK.
+#define BMO055_TWI_CLOCK          400000 // in Hz, as set up by bricklib
+#define BMO055_TWI_READ_TIME(len) ((((len) + 3)*9*1000000)/BMO055_TWI_CLOCK) // in µs
+#define BMO055_TWI_TIMEOUT(len)   (2*BMO055_TWI_READ_TIME(len))
+
 #define REG_PAGE_ID          0x07
 
 // Page 0
@@ -187,6 +354,33 @@
 #define REG_UNIQUE_ID_E      0x5E
 #define REG_UNIQUE_ID_F      0x5F
 
+// Interrupt bits, used in REG_INT_STA, REG_INT_MSK and REG_INT_EN
+#define INT_ACC_BSX_DRDY     (1 << 0)
+#define INT_MAG_DRDY         (1 << 1)
+#define INT_GYR_AM           (1 << 2)
+#define INT_GYR_HIGH_RATE    (1 << 3)
+#define INT_GYR_DRDY         (1 << 4)
+#define INT_ACC_HIGH_G       (1 << 5)
+#define INT_ACC_AM           (1 << 6)
+#define INT_ACC_NM           (1 << 7)
+
+#define ACC_CONFIG_RANGE_POS        0
+#define ACC_CONFIG_BANDWIDTH_POS    2
+#define GYR_CONFIG_0_RANGE_POS      0
+#define GYR_CONFIG_0_BANDWIDTH_POS  3
+#define MAG_CONFIG_DATA_RATE_POS    0
+#define MAG_CONFIG_OPR_MODE_REGULAR (1 << 3)
+
+#define INT_MOTION_MASK      (INT_GYR_AM | INT_ACC_HIGH_G | INT_ACC_AM | INT_ACC_NM)
+
+#define ACC_INT_SETTINGS_AM_NM_XYZ (7 << 2)
+#define ACC_INT_SETTINGS_HG_XYZ    (7 << 5)
+#define ACC_NM_SET_DURATION_POS    1
+#define GYR_INT_SETTINGS_AM_XYZ    (7 << 0)
+
+#define SYS_TRIGGER_RST_INT  (1 << 6)
+#define SYS_TRIGGER_CLK_SEL  (1 << 7)
+
 typedef struct {
 	int16_t acc_x; // 1m/s^2 = 100 LSB
 	int16_t acc_y;
@@ -214,6 +408,46 @@ typedef struct {
 	uint8_t calibration_status;
 } __attribute__((packed)) SensorData;
 
+// Appended to callbacks and getters if enabled with set_sample_info
+typedef struct {
+	uint32_t timestamp; // in µs, when the read of the sample completed
+	uint32_t sequence;  // incremented with every sample read
+} __attribute__((packed)) SampleInfo;
+
+typedef struct {
+	uint8_t offset; // in SensorData and relative to REG_ACC_DATA_X_LSB
+	uint8_t length;
+} IMUReadWindow;
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;   // in cycles
+	uint32_t max;   // in cycles
+	uint64_t sum;   // in cycles
+	uint32_t overruns; // only counted for the tick stages
+} IMUPerfStatistics;
+
+typedef struct {
+	uint8_t interrupts;              // INT_GYR_AM, INT_ACC_HIGH_G, INT_ACC_AM, INT_ACC_NM
+	uint8_t any_motion_threshold;    // see 3.5.2 for the units of all values
+	uint8_t any_motion_duration;     // 0-3, number of samples - 1
+	uint8_t no_motion_threshold;
+	uint8_t no_motion_duration;      // 0-63
+	uint8_t high_g_threshold;
+	uint8_t high_g_duration;
+	uint8_t gyroscope_any_motion_threshold; // 0-127
+} __attribute__((packed)) IMUMotionConfiguration;
+
+typedef struct {
+	uint8_t mode;
+	uint16_t threshold;
+	uint32_t keepalive;       // in ms, 0 = no keepalive
+	int32_t quaternion_limit; // cos(threshold/2) scaled like a product of two quaternion values
+	bool force;
+	uint32_t last_time;
+	int16_t last_values[4];
+} IMUThreshold;
+
 #define IMU_CALIBRATION_PASSWORD 0xDEADBEEF
 #define IMU_CALIBRATION_LENGTH (sizeof(IMUCalibration) - sizeof(uint32_t))
 #define IMU_CALIBRATION_ADDRESS (END_OF_BRICKLET_MEMORY - 0x400)
@@ -226,28 +460,131 @@ typedef struct {
 	uint32_t password;
 } __attribute__((packed)) IMUCalibration;
 
+// The calibration is stored as a log of records in the first three pages
+// of the calibration region (the last page holds the sensor
+// configuration). A new record is written to the slot after the newest
+// one. With 24 slots in three pages a page is erased once per 24 saves,
+// on every eighth write to that page.
+#define IMU_CALIBRATION_LOG_SIZE        0x300
+#define IMU_CALIBRATION_RECORD_SIZE     32
+#define IMU_CALIBRATION_SLOTS           (IMU_CALIBRATION_LOG_SIZE/IMU_CALIBRATION_RECORD_SIZE)
+#define IMU_CALIBRATION_SLOTS_PER_PAGE  (IFLASH_PAGE_SIZE/IMU_CALIBRATION_RECORD_SIZE)
+#define IMU_CALIBRATION_SLOT_NONE       0xFF
+typedef struct {
+	IMUCalibration calibration;
+	uint32_t sequence; // the record with the highest sequence is the newest
+	uint16_t crc;      // crc16 of everything before it
+} __attribute__((packed)) IMUCalibrationRecord;
+
+#define IMU_SENSOR_CONFIGURATION_PASSWORD 0xC0FFEE01
+#define IMU_SENSOR_CONFIGURATION_ADDRESS (END_OF_BRICKLET_MEMORY - 0x100)
 typedef struct {
-	const int16_t acc_offset[3];
-	const int16_t mag_offset[3];
-	const int16_t gyr_offset[3];
-	const int16_t acc_radius;
-	const int16_t mag_radius;
-	const uint32_t password;
-} __attribute__((packed)) IMUCalibrationConst;
+	uint8_t accelerometer_range;
+	uint8_t accelerometer_bandwidth;
+	uint8_t gyroscope_range;
+	uint8_t gyroscope_bandwidth;
+	uint8_t magnetometer_rate;
+	uint8_t operation_mode;
+	uint32_t password;
+} __attribute__((packed)) IMUSensorConfiguration;
 
 void tick_task(const uint8_t tick_type);
 void make_period_callback(const uint8_t type);
 
 void update_sensor_data(void);
+void imu_get_sensor_data(SensorData *data, SampleInfo *info);
+uint32_t imu_get_timestamp(void);
+uint32_t imu_get_timestamp_from_isr(void);
+uint16_t imu_get_active_channels(const uint32_t time);
+uint16_t imu_get_due_channels(const uint32_t time);
+uint16_t imu_period_channel_mask(const uint8_t type);
+uint32_t imu_get_effective_period(const uint8_t type);
+void imu_set_periods(const uint32_t *periods);
+uint16_t imu_get_min_acquisition_period(void);
+uint32_t imu_get_output_period(void);
+void imu_count_missed_samples(const uint16_t channels, const uint32_t timestamp);
+uint16_t imu_get_valid_channels(const uint8_t mode);
+void imu_set_operation_mode(const uint8_t mode);
+void imu_channel_used(const uint16_t channels);
+uint16_t imu_get_stale_channels(const uint16_t channels, const uint32_t time);
+void imu_get_fresh_sensor_data(const uint16_t channels, SensorData *data, SampleInfo *info);
+uint8_t imu_plan_reads(const uint16_t channels, IMUReadWindow *windows);
+uint8_t imu_get_channel_values(const SensorData *data, const uint8_t channel, int16_t *values);
+uint8_t imu_pack_channels(const SensorData *data, const uint16_t channels, int16_t *values);
+
+void imu_threshold_configure(const uint8_t type, const uint8_t mode, const uint16_t threshold, const uint32_t keepalive);
+bool imu_threshold_check(const uint8_t type, const SensorData *data);
+
+void imu_compact_configure(const uint16_t channels, const uint8_t keyframe_interval);
+void make_compact_stream_callback(const SensorData *data, const SampleInfo *info);
+void make_channel_data_callback(const SensorData *data, const SampleInfo *info);
+void imu_perf_init(void);
+void imu_perf_reset(void);
+void imu_perf_get(const uint8_t stage, IMUPerfStatistics *perf);
+void imu_perf_record(const uint8_t stage, const uint32_t cycles);
+void imu_send_message(const void *data, const uint8_t length, const ComType com);
+uint8_t imu_add_sample_info(uint8_t *message, const void *data, const uint8_t length, const SampleInfo *info);
+void imu_send_sample(const void *data, const uint8_t length, const ComType com, const SampleInfo *info);
+void imu_send_callback(const void *data, const uint8_t length, const SampleInfo *info, const uint8_t type);
+void imu_flush_callbacks(void);
+void imu_latency_record(const uint8_t type, const uint32_t timestamp);
+void imu_latency_reset(void);
+void imu_latency_get(const uint8_t type, uint32_t *histogram);
+
+uint8_t imu_buffer_get_sample_size(const uint16_t channels);
+uint8_t imu_buffer_get_samples_per_message(const uint16_t channels);
+void imu_buffer_configure(const uint16_t channels, const uint8_t watermark);
+void imu_buffer_push(const SensorData *data, const uint32_t timestamp);
+uint8_t imu_buffer_pop(uint8_t *data, const uint8_t count, uint16_t *samples_lost);
+void imu_buffer_callback(void);
+void imu_int_handler(const Pin *pin);
+void imu_set_acquisition_mode(const uint8_t mode);
+void imu_update_idle_state(const uint32_t time);
+bool imu_power_switch_request(const uint8_t power_mode);
+void imu_power_switch_tick(void);
+void imu_power_switch_finish(void);
+void imu_wake(void);
+bool imu_mode_try_take(void);
+void imu_mode_take(void);
+void imu_mode_give(void);
+void imu_set_motion_configuration(const IMUMotionConfiguration *config);
+void imu_configure_interrupts(void);
+bool imu_int_used(void);
+void imu_reset_int(void);
+void imu_enable_int(void);
+void imu_read_interrupt_status(void);
+void imu_motion_callback(void);
 
 void imu_blinkenlights(void);
 void imu_leds_on(const bool on);
 void bmo_read_register(const uint8_t reg, uint8_t *data, const uint8_t length);
 void bmo_read_registers(const uint8_t reg, uint8_t *data, const uint8_t length);
+void bmo_abort_transfer(void);
+bool bmo_read_registers_async(const uint8_t reg, uint8_t *data, const uint8_t length);
+void bmo_write_register(const uint8_t reg, uint8_t const value);
+void bmo_set_operation_mode(const uint8_t mode);
 void bmo_write_registers(const uint8_t reg, const uint8_t *data, const uint8_t length);
 
-bool read_calibration_from_bno055_and_save_to_flash(void);
+bool imu_calibration_record_valid(const IMUCalibrationRecord *record);
+const IMUCalibration *imu_calibration_find(void);
+bool imu_calibration_log_write(const IMUCalibration *calibration);
+bool imu_calibration_save_start(void);
+bool imu_calibration_save_request(const bool automatic);
+void imu_calibration_save_tick(void);
+void imu_calibration_save_finish(const bool success);
+bool imu_calibration_save_in_config_mode(void);
+void imu_calibration_saved_callback(void);
+bool imu_calibration_differs(const IMUCalibration *calibration);
+bool imu_calibration_watch(void);
+void imu_calibration_update_status(const uint8_t calibration_status, const uint32_t time);
+void imu_calibration_status_changed_callback(void);
 bool read_calibration_from_flash_and_save_to_bno055(void);
+bool imu_flash_write(const uint32_t address, const void *data, const uint32_t length);
+
+void write_sensor_configuration_to_bno055(void);
+void imu_set_sensor_configuration(const IMUSensorConfiguration *config);
+bool save_sensor_configuration_to_flash(void);
+void read_sensor_configuration_from_flash(void);
 void imu_init(void);
 
 #endif